@@ -5,20 +5,32 @@ OS="$(uname -s)"
 ARCH="$(uname -m)"
 
 if [ "$OS" = "Linux" ] && [ "$ARCH" = "x86_64" ]; then
-    g++ -std=c++17 -O3 -Wall \
+    g++ -std=c++17 -O3 -Wall $CXXFLAGS \
         -Iinc \
         -Llib_linux_x86_64 \
         src/main.cpp -o muludnep \
         -Wl,-rpath,lib_linux_x86_64 \
         -lGL -lmujoco -limgui -lglfw3
+    g++ -std=c++17 -O3 -Wall $CXXFLAGS -shared -fPIC \
+        -Iinc \
+        -Llib_linux_x86_64 \
+        src/vecenv_lib.cpp -o libmuludnep.so \
+        -Wl,-rpath,lib_linux_x86_64 \
+        -lmujoco -lpthread
 elif [ "$OS" = "Darwin" ] && [ "$ARCH" = "arm64" ]; then
-    clang++ -std=c++17 -O3 -Wall \
+    clang++ -std=c++17 -O3 -Wall $CXXFLAGS \
         -Iinc \
         -Llib_darwin_aarch64 \
         src/main.cpp -o muludnep \
         -Wl,-rpath,lib_darwin_aarch64 \
         -framework Cocoa -framework IOKit -framework OpenGL \
         -lmujoco -limgui -lglfw3
+    clang++ -std=c++17 -O3 -Wall $CXXFLAGS -dynamiclib \
+        -Iinc \
+        -Llib_darwin_aarch64 \
+        src/vecenv_lib.cpp -o libmuludnep.dylib \
+        -Wl,-rpath,lib_darwin_aarch64 \
+        -lmujoco
 else
     echo "unsupported platform: $OS ($ARCH)"
     exit 1
@@ -0,0 +1,232 @@
+#include "base.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Heap-allocation guard for the step loop. Compiled in with -DALLOC_GUARD, otherwise the region markers are no-ops.
+// Inside a region marked with alloc_guard_begin/alloc_guard_end every heap allocation is either counted and its call
+// site recorded (count mode) or reported and aborted on (forbid mode).
+
+enum alloc_mode {
+    ALLOC_OFF,
+    ALLOC_COUNT,
+    ALLOC_FORBID,
+};
+
+void alloc_guard_init(world *w);
+void alloc_guard_begin(const char *region);
+void alloc_guard_end();
+void alloc_guard_report();
+u64 alloc_guard_count();
+i32 alloc_guard_sites();
+
+#ifdef ALLOC_GUARD
+#include <execinfo.h>
+
+#define ALLOC_MAX_SITES 32
+#define ALLOC_MAX_FRAMES 12
+
+typedef struct alloc_site {
+    const char *region;
+    void *frames[ALLOC_MAX_FRAMES];
+    i32 nframes;
+    u64 hash;
+    u64 count;
+} alloc_site;
+
+static alloc_mode alloc_guard_mode;
+static alloc_site alloc_sites[ALLOC_MAX_SITES];
+static i32 alloc_nsites;
+static u64 alloc_count;
+static thread_local const char *alloc_region;
+static thread_local i32 alloc_depth;
+static thread_local bool alloc_in_hook;
+
+void
+alloc_note(size_t size)
+{
+    if (!alloc_depth || alloc_in_hook) return;
+    alloc_in_hook = true;
+
+    void *frames[ALLOC_MAX_FRAMES];
+    i32 nframes = backtrace(frames, ALLOC_MAX_FRAMES);
+    if (alloc_guard_mode == ALLOC_FORBID)
+    {
+        fprintf(stderr, "alloc guard: %zu byte allocation inside '%s'\n", size, alloc_region);
+        backtrace_symbols_fd(frames, nframes, 2);
+        abort();
+    }
+
+    alloc_count++;
+    u64 hash = 1469598103934665603ull;
+    for (i32 i = 0; i < nframes; i++)
+        hash = (hash ^ (u64)frames[i]) * 1099511628211ull;
+    for (i32 i = 0; i < alloc_nsites; i++)
+    {
+        if (alloc_sites[i].hash == hash)
+        {
+            alloc_sites[i].count++;
+            alloc_in_hook = false;
+            return;
+        }
+    }
+    if (alloc_nsites < ALLOC_MAX_SITES)
+    {
+        alloc_site *site = &alloc_sites[alloc_nsites++];
+        site->region = alloc_region;
+        memcpy(site->frames, frames, sizeof(void *) * nframes);
+        site->nframes = nframes;
+        site->hash = hash;
+        site->count = 1;
+    }
+    alloc_in_hook = false;
+}
+
+#if defined(__GLIBC__)
+// glibc lets the executable replace the malloc family; forward to the libc implementation after taking note
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+extern "C" void *
+malloc(size_t size)
+{
+    alloc_note(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void *
+calloc(size_t n, size_t size)
+{
+    alloc_note(n * size);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *
+realloc(void *ptr, size_t size)
+{
+    alloc_note(size);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#else
+// no malloc interposition outside glibc: catch operator new, Eigen is covered by EIGEN_RUNTIME_NO_MALLOC
+#include <new>
+
+void *
+operator new(size_t size)
+{
+    alloc_note(size);
+    void *p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+void
+alloc_guard_init(world *w)
+{
+    alloc_guard_mode = (alloc_mode)w->alloc_mode;
+    // backtrace loads its unwinder lazily, which allocates; do it once outside any region
+    void *frames[1];
+    backtrace(frames, 1);
+}
+
+void
+alloc_guard_begin(const char *region)
+{
+    if (alloc_guard_mode == ALLOC_OFF) return;
+    if (alloc_depth++ == 0)
+    {
+        alloc_region = region;
+        if (alloc_guard_mode == ALLOC_FORBID) Eigen::internal::set_is_malloc_allowed(false);
+    }
+}
+
+void
+alloc_guard_end()
+{
+    if (alloc_guard_mode == ALLOC_OFF) return;
+    if (--alloc_depth == 0)
+    {
+        alloc_region = NULL;
+        if (alloc_guard_mode == ALLOC_FORBID) Eigen::internal::set_is_malloc_allowed(true);
+    }
+}
+
+u64
+alloc_guard_count()
+{
+    return alloc_count;
+}
+
+i32
+alloc_guard_sites()
+{
+    return alloc_nsites;
+}
+
+void
+alloc_guard_report()
+{
+    if (alloc_guard_mode == ALLOC_OFF) return;
+    printf("alloc guard: %llu allocations in marked regions from %d call sites\n", (unsigned long long)alloc_count, alloc_nsites);
+    for (i32 i = 0; i < alloc_nsites; i++)
+    {
+        printf("alloc guard: site %d in '%s', %llu allocations:\n", i, alloc_sites[i].region, (unsigned long long)alloc_sites[i].count);
+        fflush(stdout);
+        backtrace_symbols_fd(alloc_sites[i].frames, alloc_sites[i].nframes, 1);
+    }
+}
+#else
+void
+alloc_guard_init(world *w)
+{
+    if (w->alloc_mode != ALLOC_OFF) fprintf(stderr, "alloc guard: not compiled in, rebuild with CXXFLAGS=-DALLOC_GUARD\n");
+}
+
+inline void
+alloc_guard_begin(const char *region)
+{
+}
+
+inline void
+alloc_guard_end()
+{
+}
+
+u64
+alloc_guard_count()
+{
+    return 0;
+}
+
+i32
+alloc_guard_sites()
+{
+    return 0;
+}
+
+void
+alloc_guard_report()
+{
+}
+#endif
@@ -0,0 +1,202 @@
+#include "base.hpp"
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Offline analysis of a directory of telemetry logs (--analyze DIR). Each file is memory-mapped through
+// telemetry_reader and streamed block by block, decoding only the time, state and force columns; files are spread over
+// worker threads and the per-run metrics are printed as one table.
+//
+// metrics, over both pole angles x(1) and y(1):
+//   settle    time from the first sample until |angle| last leaves the 2% band of its peak
+//   overshoot largest excursion past zero opposite to the initial tilt, in percent of the initial tilt
+//   rms       root mean square of the tilt magnitude
+//   peak      largest |ux| or |uy|
+//   cost      integral of x'Qx + R ux^2 + y'Qy + R uy^2 using the Q and R stored in the log header
+
+#define ANALYZE_SETTLE_BAND 0.02
+#define ANALYZE_MIN_TILT 1e-6
+
+typedef struct run_metrics {
+    std::string path;
+    bool ok;
+    u64 samples;
+    f64 duration;
+    f64 settle;
+    f64 overshoot;
+    f64 rms_angle;
+    f64 peak_force;
+    f64 cost;
+} run_metrics;
+
+i32 analyze_logs(const char *dir, i32 threads);
+
+void
+analyze_run(run_metrics *m)
+{
+    telemetry_reader r = {};
+    m->ok = telemetry_reader_open(&r, m->path.c_str()) && r.nsamples > 1;
+    if (!m->ok)
+    {
+        telemetry_reader_close(&r);
+        return;
+    }
+    const telemetry_header *h = &r.header;
+    Eigen::Map<const Eigen::Matrix<f64, nstate, nstate> > Q(h->Q);
+    const u32 x_col = 1;
+    const u32 y_col = 1 + nstate;
+    const u32 ux_col = 1 + 2 * nstate;
+    const u32 uy_col = 2 + 2 * nstate;
+
+    // pass 1: everything that needs only a running sum or extreme
+    f64 t_first = 0, t_prev = 0, t_last = 0;
+    f64 tilt0[2] = { 0, 0 };
+    f64 past_zero[2] = { 0, 0 };
+    f64 peak_tilt = 0, sum_sq = 0, peak_force = 0, cost = 0;
+    for (u64 b = 0; b < r.blocks.size(); b++)
+    {
+        u32 n = r.blocks[b].nsamples;
+        const f64 *t = telemetry_reader_column(&r, b, 0);
+        const f64 *u[2] = { telemetry_reader_column(&r, b, ux_col), telemetry_reader_column(&r, b, uy_col) };
+        const f64 *s[2][nstate];
+        for (i32 k = 0; k < nstate; k++)
+        {
+            s[0][k] = telemetry_reader_column(&r, b, x_col + k);
+            s[1][k] = telemetry_reader_column(&r, b, y_col + k);
+        }
+
+        for (u32 i = 0; i < n; i++)
+        {
+            if (!b && !i)
+            {
+                t_first = t_prev = t[0];
+                tilt0[0] = s[0][1][0];
+                tilt0[1] = s[1][1][0];
+            }
+            f64 dt = t[i] - t_prev;
+            t_prev = t[i];
+            f64 tilt_sq = 0;
+            for (i32 a = 0; a < 2; a++)
+            {
+                f64 angle = s[a][1][i];
+                tilt_sq += angle * angle;
+                if (fabs(tilt0[a]) > ANALYZE_MIN_TILT) past_zero[a] = mjMAX(past_zero[a], -angle * (tilt0[a] > 0 ? 1 : -1));
+                peak_force = mjMAX(peak_force, fabs(u[a][i]));
+
+                Eigen::Matrix<f64, nstate, 1> v;
+                for (i32 k = 0; k < nstate; k++)
+                    v(k) = s[a][k][i];
+                cost += (v.dot(Q * v) + h->R * u[a][i] * u[a][i]) * dt;
+            }
+            sum_sq += tilt_sq;
+            peak_tilt = mjMAX(peak_tilt, sqrt(tilt_sq));
+        }
+        t_last = t[n - 1];
+    }
+
+    // pass 2: last time the tilt was outside the band, only touching the blocks whose range can exceed it
+    f64 band = ANALYZE_SETTLE_BAND * peak_tilt;
+    f64 t_out = t_first;
+    for (u64 b = r.blocks.size(); b-- > 0;)
+    {
+        bool outside = false;
+        for (u32 col : { x_col + 1, y_col + 1 })
+            outside |= mjMAX(fabs(telemetry_reader_col_min(&r, b, col)), fabs(telemetry_reader_col_max(&r, b, col))) > band / sqrt(2.0);
+        if (!outside) continue;
+
+        const f64 *t = telemetry_reader_column(&r, b, 0);
+        const f64 *ax = telemetry_reader_column(&r, b, x_col + 1);
+        const f64 *ay = telemetry_reader_column(&r, b, y_col + 1);
+        i64 i = r.blocks[b].nsamples - 1;
+        while (i >= 0 && ax[i] * ax[i] + ay[i] * ay[i] <= band * band)
+            i--;
+        if (i >= 0)
+        {
+            t_out = t[i];
+            break;
+        }
+    }
+
+    f64 overshoot = 0;
+    for (i32 a = 0; a < 2; a++)
+        if (fabs(tilt0[a]) > ANALYZE_MIN_TILT) overshoot = mjMAX(overshoot, 100.0 * past_zero[a] / fabs(tilt0[a]));
+
+    m->samples = r.nsamples;
+    m->duration = t_last - t_first;
+    m->settle = t_out >= t_last ? NAN : t_out - t_first;
+    m->overshoot = overshoot;
+    m->rms_angle = sqrt(sum_sq / r.nsamples);
+    m->peak_force = peak_force;
+    m->cost = cost;
+    telemetry_reader_close(&r);
+}
+
+// returns a process exit code
+i32
+analyze_logs(const char *dir, i32 threads)
+{
+    std::vector<run_metrics> runs;
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        // a single log is fine too
+        runs.push_back({ dir });
+    }
+    else
+    {
+        while (struct dirent *e = readdir(d))
+        {
+            std::string name = e->d_name;
+            if (name.size() > 6 && name.compare(name.size() - 6, 6, ".mplog") == 0) runs.push_back({ std::string(dir) + "/" + name });
+        }
+        closedir(d);
+    }
+    if (runs.empty())
+    {
+        fprintf(stderr, "analyze: no .mplog files in %s\n", dir);
+        return 1;
+    }
+    std::sort(runs.begin(), runs.end(), [](const run_metrics &a, const run_metrics &b) { return a.path < b.path; });
+
+    if (threads <= 0) threads = (i32)std::thread::hardware_concurrency();
+    threads = mjMAX(1, mjMIN(threads, (i32)runs.size()));
+    i64 start = now_ns();
+    std::atomic<u64> next(0);
+    std::vector<std::thread> pool;
+    for (i32 i = 0; i < threads; i++)
+        pool.emplace_back([&]() {
+            for (u64 j; (j = next.fetch_add(1)) < runs.size();)
+                analyze_run(&runs[j]);
+        });
+    for (std::thread &t : pool)
+        t.join();
+    f64 seconds = (now_ns() - start) * 1e-9;
+
+    u64 total = 0;
+    printf("%-32s %10s %9s %9s %10s %10s %10s %12s\n", "log", "samples", "duration", "settle", "overshoot", "rms angle", "peak force", "lqr cost");
+    for (const run_metrics &m : runs)
+    {
+        const char *slash = strrchr(m.path.c_str(), '/');
+        const char *name = slash ? slash + 1 : m.path.c_str();
+        if (!m.ok)
+        {
+            printf("%-32s unreadable\n", name);
+            continue;
+        }
+        total += m.samples;
+        printf("%-32s %10llu %8.2fs ", name, (unsigned long long)m.samples, m.duration);
+        if (isnan(m.settle))
+            printf("%9s ", "-");
+        else
+            printf("%8.2fs ", m.settle);
+        printf("%9.1f%% %9.4f %10.2fN %12.4g\n", m.overshoot, m.rms_angle, m.peak_force, m.cost);
+    }
+    printf("%zu logs, %llu samples in %.3f s on %d threads (%.1f M samples/s)\n", runs.size(), (unsigned long long)total, seconds, threads,
+           total / seconds * 1e-6);
+    return 0;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#ifdef ALLOC_GUARD
+#define EIGEN_RUNTIME_NO_MALLOC
+#endif
 #include <Eigen/Dense>
 #include <GLFW/glfw3.h>
 #include <mujoco/mujoco.h>
@@ -10,6 +13,8 @@
 #define PANEL_WIDTH 500.0f
 #define nstate 4
 #define nact 1
+#define RT_HIST_BINS 16
+#define STARTUP_MAX_STAGES 8
 
 typedef int8_t i8;
 typedef int16_t i16;
@@ -23,6 +28,20 @@ typedef uint64_t u64;
 typedef float f32;
 typedef double f64;
 
+struct telemetry_recorder;
+struct replay_state;
+struct rewind_buffer;
+struct plot_history;
+struct locus_state;
+struct freq_response;
+struct gain_cache;
+struct reload_state;
+struct params_state;
+struct fleet_state;
+struct ext_link;
+struct stream_publisher;
+struct metrics_state;
+
 typedef struct world {
     // MuJoCo info
     mjModel *model;
@@ -42,11 +61,43 @@ typedef struct world {
     i32 hinge_x_qvel_id;
     i32 hinge_y_qvel_id;
 
+    // physical parameters edited through the retained mjSpec (see params.cpp)
     f64 pole_mass;
+    f64 pole_length;
     f64 platform_mass;
+    params_state *params;
+    u64 model_hash;
+
+    // compiled-model cache and startup timing (see model.cpp)
+    bool model_cache = true;
+    bool model_from_cache;
+    char cache_dir[256] = "cache";
+    char scene_path[256]; // load and hot-reload the model from this file instead of scene[] (see reload.cpp)
+    reload_state *reload;
+    i64 startup_start_ns;
+    i64 startup_mark_ns;
+    i32 startup_nstages;
+    const char *startup_stage[STARTUP_MAX_STAGES];
+    f64 startup_ms[STARTUP_MAX_STAGES];
 
     Eigen::Matrix<f64, nstate, nstate> Q;
     Eigen::Matrix<f64, nact, nstate> K;
+    f64 R = 1.0;
+    // linearization behind K and the closed-loop poles eig(A - BK), refreshed on every gain update
+    Eigen::Matrix<f64, nstate, nstate> A;
+    Eigen::Matrix<f64, nstate, nact> B;
+    Eigen::Matrix<std::complex<f64>, nstate, 1> poles;
+    locus_state *locus;
+    i32 locus_weight = 1;
+
+    // synthesis cache (see gains.cpp)
+    gain_cache *gains;
+    bool use_gain_cache = true;
+    f32 gain_tolerance = 0.01f;
+    i32 gain_source;
+    u64 gain_recomputes; // syntheses, including background ones for reloads and parameter edits
+    u64 care_failures;   // of those, how many found no stabilizing solution
+    freq_response *freq;
     Eigen::Matrix<f64, nstate, 1> x;
     Eigen::Matrix<f64, nstate, 1> y;
     f64 ux;
@@ -75,7 +126,105 @@ typedef struct world {
     f32 pole_start_angle_x;
     f32 pole_start_angle_y;
     bool pole_start_angle_random;
+    u64 seed;    // random start angles are drawn from (seed, episode) (see rng.cpp)
+    u32 episode; // resets of the main pendulum so far
     bool focus_robot;
+
+    // real-time loop
+    bool rt_enabled;
+    i32 rt_cpu;
+    i32 rt_priority;
+    bool rt_locked;
+    bool rt_pinned;
+    bool rt_fifo;
+    i64 rt_period_ns;
+    i64 rt_next_ns;
+    u64 rt_periods;
+    u64 rt_misses;
+    i64 rt_max_jitter_ns;
+    u64 rt_jitter_hist[RT_HIST_BINS];
+
+    // loop rates: physics substeps and control (zero-order hold) per render frame
+    f32 physics_hz = 100.0f;
+    f32 control_hz = 100.0f;
+    f32 render_hz = 60.0f;
+    f64 steps_owed;
+    f64 next_control_time;
+    i64 frame_next_ns;
+    u64 physics_steps;
+    u64 control_updates;
+    u64 render_frames;
+    f64 measured_physics_hz;
+    f64 measured_control_hz;
+    f64 measured_render_hz;
+    f64 measured_rtf;
+    i64 rate_window_start_ns;
+    u64 rate_window_physics_steps;
+    u64 rate_window_control_updates;
+    u64 rate_window_render_frames;
+    f64 rate_window_sim_time;
+
+    // adaptive substepping: pick substeps per frame from the measured step cost to hold target_rtf
+    bool adaptive_substeps;
+    f32 target_rtf = 1.0f;
+    f32 physics_budget = 0.5f;
+    f32 min_timestep = 0.0005f;
+    f32 max_timestep = 0.01f;
+    f64 step_cost_ns;
+    bool falling_behind;
+
+    // run the LQR law inside mj_step through mjcb_control instead of once per control period
+    bool control_in_mujoco;
+
+    // out-of-process controller over shared memory (see extctl.cpp); the LQR law covers deadline misses
+    char ext_name[64];
+    ext_link *ext;
+    i32 ext_deadline_us = 1000;
+    char ext_client_name[64]; // run the reference controller instead of the simulator
+
+    // per-step telemetry recording (see telemetry.cpp)
+    telemetry_recorder *recorder;
+    char telemetry_path[256] = "run.mplog";
+    bool telemetry_autostart;
+    bool telemetry_compress = true;
+    f64 telemetry_quantum; // 0: lossless
+
+    // live per-step samples to local subscribers over a Unix socket (see stream.cpp)
+    char stream_path[108];
+    stream_publisher *stream;
+
+    // loop health counters in the OpenMetrics text format, to a file and/or a Unix socket (see metrics.cpp)
+    char metrics_path[256];
+    char metrics_socket[108];
+    metrics_state *metrics;
+
+    // replay of a recorded log (see replay.cpp); the live sim is paused while it is open
+    replay_state *replay;
+    char replay_path[256] = "run.mplog";
+
+    // bounded in-memory history for rewinding the live sim (see rewind.cpp)
+    rewind_buffer *rewind;
+    f32 rewind_seconds = 1.0f;
+
+    // min/max pyramid behind the scrolling panel plots (see plot.cpp)
+    plot_history *plots;
+    f32 plot_seconds = 10.0f;
+
+    // extra pendulums sharing the model (see fleet.cpp)
+    i32 fleet_size;
+    fleet_state *fleet;
+    f32 fleet_gain_spread; // fleet K scaled from 1 - spread to 1 + spread across the pendulums
+    i32 bench_control_n;   // run the control-law benchmark instead of the simulator (see batch.cpp)
+
+    // offline log analysis (see analyze.cpp); runs instead of the simulator when a path is given
+    char analyze_path[256];
+    i32 analyze_threads;
+
+    // determinism harness over this many vectorized environments (see determinism.cpp); runs instead of the simulator
+    i32 verify_determinism_n;
+
+    // heap-allocation guard (see alloc.cpp)
+    i32 alloc_mode;
 } world;
 
 const char scene[] = "<mujoco model=\"cartpole\">"
@@ -0,0 +1,249 @@
+#include "base.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86
+#endif
+
+// Batched control law u = -K x over n environments whose state is stored structure of arrays (x[k * n + i] is state
+// component k of environment i). K is either one gain shared by every environment or one per environment, laid out the
+// same way as the state (K[k * n + i]) for gain sweeps. Each variant has a portable kernel plus AVX2+FMA and AVX-512
+// kernels built with target attributes, so the binary needs no special flags; the widest one the CPU supports is picked
+// once at startup. --bench-control times them against the per-world Eigen path that control() uses.
+
+enum batch_isa
+{
+    BATCH_PORTABLE,
+    BATCH_AVX2,
+    BATCH_AVX512,
+    BATCH_ISA_COUNT,
+};
+
+typedef void (*batch_kernel)(const f64 *K, const f64 *x, f64 *u, i32 n);
+
+void batch_control(const f64 *K, bool per_env, const f64 *x, f64 *u, i32 n);
+i32 bench_control(i32 n);
+
+const char *batch_isa_names[BATCH_ISA_COUNT] = { "portable", "avx2", "avx512" };
+
+// [i, n) of the shared-K law; also the tail of the SIMD kernels. It rounds exactly like one of their lanes, a product
+// then fused multiply-adds in the same order, so an environment's control does not depend on its index, the batch size
+// or the ISA.
+void
+batch_shared_range(const f64 *K, const f64 *x, f64 *u, i32 n, i32 i)
+{
+    for (; i < n; i++)
+    {
+        f64 acc = -K[0] * x[i];
+        for (i32 k = 1; k < nstate; k++)
+            acc = fma(-K[k], x[k * n + i], acc);
+        u[i] = acc;
+    }
+}
+
+void
+batch_per_env_range(const f64 *K, const f64 *x, f64 *u, i32 n, i32 i)
+{
+    for (; i < n; i++)
+    {
+        f64 acc = K[i] * x[i];
+        for (i32 k = 1; k < nstate; k++)
+            acc = fma(K[k * n + i], x[k * n + i], acc);
+        u[i] = 0.0 - acc;
+    }
+}
+
+// portable kernels: one pass over the environments with the same rounding as the SIMD lanes
+void
+batch_shared_portable(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    batch_shared_range(K, x, u, n, 0);
+}
+
+void
+batch_per_env_portable(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    batch_per_env_range(K, x, u, n, 0);
+}
+
+#ifdef BATCH_X86
+__attribute__((target("avx2,fma"))) void
+batch_shared_avx2(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    __m256d k0 = _mm256_set1_pd(-K[0]);
+    __m256d k1 = _mm256_set1_pd(-K[1]);
+    __m256d k2 = _mm256_set1_pd(-K[2]);
+    __m256d k3 = _mm256_set1_pd(-K[3]);
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d acc = _mm256_mul_pd(k0, _mm256_loadu_pd(x + i));
+        acc = _mm256_fmadd_pd(k1, _mm256_loadu_pd(x + n + i), acc);
+        acc = _mm256_fmadd_pd(k2, _mm256_loadu_pd(x + 2 * n + i), acc);
+        acc = _mm256_fmadd_pd(k3, _mm256_loadu_pd(x + 3 * n + i), acc);
+        _mm256_storeu_pd(u + i, acc);
+    }
+    batch_shared_range(K, x, u, n, i);
+}
+
+__attribute__((target("avx2,fma"))) void
+batch_per_env_avx2(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d acc = _mm256_mul_pd(_mm256_loadu_pd(K + i), _mm256_loadu_pd(x + i));
+        acc = _mm256_fmadd_pd(_mm256_loadu_pd(K + n + i), _mm256_loadu_pd(x + n + i), acc);
+        acc = _mm256_fmadd_pd(_mm256_loadu_pd(K + 2 * n + i), _mm256_loadu_pd(x + 2 * n + i), acc);
+        acc = _mm256_fmadd_pd(_mm256_loadu_pd(K + 3 * n + i), _mm256_loadu_pd(x + 3 * n + i), acc);
+        _mm256_storeu_pd(u + i, _mm256_sub_pd(_mm256_setzero_pd(), acc));
+    }
+    batch_per_env_range(K, x, u, n, i);
+}
+
+__attribute__((target("avx512f"))) void
+batch_shared_avx512(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    __m512d k0 = _mm512_set1_pd(-K[0]);
+    __m512d k1 = _mm512_set1_pd(-K[1]);
+    __m512d k2 = _mm512_set1_pd(-K[2]);
+    __m512d k3 = _mm512_set1_pd(-K[3]);
+    i32 i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d acc = _mm512_mul_pd(k0, _mm512_loadu_pd(x + i));
+        acc = _mm512_fmadd_pd(k1, _mm512_loadu_pd(x + n + i), acc);
+        acc = _mm512_fmadd_pd(k2, _mm512_loadu_pd(x + 2 * n + i), acc);
+        acc = _mm512_fmadd_pd(k3, _mm512_loadu_pd(x + 3 * n + i), acc);
+        _mm512_storeu_pd(u + i, acc);
+    }
+    batch_shared_range(K, x, u, n, i);
+}
+
+__attribute__((target("avx512f"))) void
+batch_per_env_avx512(const f64 *K, const f64 *x, f64 *u, i32 n)
+{
+    i32 i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d acc = _mm512_mul_pd(_mm512_loadu_pd(K + i), _mm512_loadu_pd(x + i));
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(K + n + i), _mm512_loadu_pd(x + n + i), acc);
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(K + 2 * n + i), _mm512_loadu_pd(x + 2 * n + i), acc);
+        acc = _mm512_fmadd_pd(_mm512_loadu_pd(K + 3 * n + i), _mm512_loadu_pd(x + 3 * n + i), acc);
+        _mm512_storeu_pd(u + i, _mm512_sub_pd(_mm512_setzero_pd(), acc));
+    }
+    batch_per_env_range(K, x, u, n, i);
+}
+#endif
+
+static_assert(nstate == 4, "the SIMD kernels unroll over four state components");
+
+const batch_kernel batch_shared_kernels[BATCH_ISA_COUNT] = {
+    batch_shared_portable,
+#ifdef BATCH_X86
+    batch_shared_avx2,
+    batch_shared_avx512,
+#endif
+};
+const batch_kernel batch_per_env_kernels[BATCH_ISA_COUNT] = {
+    batch_per_env_portable,
+#ifdef BATCH_X86
+    batch_per_env_avx2,
+    batch_per_env_avx512,
+#endif
+};
+
+// widest ISA this CPU runs
+i32
+batch_detect_isa()
+{
+#ifdef BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return BATCH_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return BATCH_AVX2;
+#endif
+    return BATCH_PORTABLE;
+}
+
+static const i32 batch_isa = batch_detect_isa();
+
+// u = -K x for n environments; K is nstate values, or nstate * n laid out like x when per_env
+void
+batch_control(const f64 *K, bool per_env, const f64 *x, f64 *u, i32 n)
+{
+    (per_env ? batch_per_env_kernels : batch_shared_kernels)[batch_isa](K, x, u, n);
+}
+
+// ns per environment of f, best of a few runs of enough repeats to last ~20 ms
+template <typename F>
+f64
+bench_ns(i32 n, F f)
+{
+    i32 repeats = 1;
+    for (;;)
+    {
+        i64 start = now_ns();
+        for (i32 r = 0; r < repeats; r++)
+            f();
+        if (now_ns() - start > 20000000) break;
+        repeats *= 2;
+    }
+    f64 best = INFINITY;
+    for (i32 run = 0; run < 5; run++)
+    {
+        i64 start = now_ns();
+        for (i32 r = 0; r < repeats; r++)
+            f();
+        best = mjMIN(best, (f64)(now_ns() - start) / repeats / n);
+    }
+    return best;
+}
+
+// --bench-control: every kernel this CPU runs against the per-world Eigen path, on random states and gains
+i32
+bench_control(i32 n)
+{
+    if (n <= 0) n = 4096;
+    std::vector<f64> x(nstate * n), K(nstate * n), u(n), reference(n), reference_per_env(n);
+    std::vector<Eigen::Matrix<f64, nstate, 1> > states(n);
+    std::vector<Eigen::Matrix<f64, nact, nstate> > gains(n);
+    Eigen::Matrix<f64, nact, nstate> shared;
+    rng_stream rng = rng_open(1, 0, 0, RNG_BENCHMARK);
+    for (i32 k = 0; k < nstate; k++)
+        shared(0, k) = rng_uniform(&rng) * 100.0;
+    for (i32 i = 0; i < n; i++)
+        for (i32 k = 0; k < nstate; k++)
+        {
+            x[k * n + i] = states[i](k) = rng_symmetric(&rng);
+            K[k * n + i] = gains[i](0, k) = shared(0, k) * (0.5 + rng_uniform(&rng));
+        }
+
+    // what control() does, one Eigen product per world
+    f64 eigen_shared = bench_ns(n, [&]() {
+        for (i32 i = 0; i < n; i++)
+            reference[i] = -(shared * states[i])(0);
+    });
+    f64 eigen_per_env = bench_ns(n, [&]() {
+        for (i32 i = 0; i < n; i++)
+            reference_per_env[i] = -(gains[i] * states[i])(0);
+    });
+
+    printf("u = -Kx over %d environments, detected ISA: %s\n", n, batch_isa_names[batch_isa]);
+    printf("%-10s %14s %9s %14s %9s %10s\n", "kernel", "shared ns/env", "speedup", "per-env ns/env", "speedup", "max error");
+    printf("%-10s %14.3f %8.2fx %14.3f %8.2fx %10s\n", "eigen", eigen_shared, 1.0, eigen_per_env, 1.0, "-");
+    for (i32 isa = 0; isa <= batch_isa; isa++)
+    {
+        f64 t_shared = bench_ns(n, [&]() { batch_shared_kernels[isa](shared.data(), x.data(), u.data(), n); });
+        f64 error = 0.0;
+        for (i32 i = 0; i < n; i++)
+            error = mjMAX(error, fabs(u[i] - reference[i]));
+        f64 t_per_env = bench_ns(n, [&]() { batch_per_env_kernels[isa](K.data(), x.data(), u.data(), n); });
+        for (i32 i = 0; i < n; i++)
+            error = mjMAX(error, fabs(u[i] - reference_per_env[i]));
+        printf("%-10s %14.3f %8.2fx %14.3f %8.2fx %10.2g\n", batch_isa_names[isa], t_shared, eigen_shared / t_shared, t_per_env,
+               eigen_per_env / t_per_env, error);
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include "base.hpp"
+#include <errno.h>
+#include <time.h>
+
+// monotonic clock shared by the loop pacing, the profilers and the library build, which has no window or rt loop
+
+i64 now_ns();
+void sleep_until_ns(i64 deadline);
+
+i64
+now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (i64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+sleep_until_ns(i64 deadline)
+{
+    timespec ts;
+    ts.tv_sec = deadline / 1000000000;
+    ts.tv_nsec = deadline % 1000000000;
+#ifdef __linux__
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#else
+    // no clock_nanosleep on darwin: sleep the remaining relative time instead
+    i64 remaining = deadline - now_ns();
+    if (remaining <= 0) return;
+    ts.tv_sec = remaining / 1000000000;
+    ts.tv_nsec = remaining % 1000000000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+#endif
+}
@@ -0,0 +1,326 @@
+#include "base.hpp"
+#include <string.h>
+
+// Column codecs for telemetry blocks:
+//   CODEC_XOR:  Gorilla-style XOR against the previous value with leading/trailing zero windows, lossless, good for
+//               columns that repeat or jump around
+//   CODEC_DOD:  delta-of-delta of the order-preserving integer mapping of the bits, zigzag + prefix-coded buckets,
+//               lossless, good for near-constant steps like time
+//   CODEC_QDOD: the same delta-of-delta on round(v / quantum), lossy by at most quantum / 2. Smooth physics signals
+//               have tiny second differences, so this is where most of the size goes.
+// Streams are MSB-first and padded so a reader can always load 8 bytes past its position.
+
+#define CODEC_XOR 0
+#define CODEC_DOD 1
+#define CODEC_QDOD 2
+
+typedef struct bit_writer {
+    u8 *p;
+    u64 acc;
+    i32 nbits;
+} bit_writer;
+
+typedef struct bit_reader {
+    const u8 *base;
+    u64 pos;
+} bit_reader;
+
+inline void
+bw_put(bit_writer *bw, u64 v, i32 n)
+{
+    if (n > 56)
+    {
+        bw_put(bw, v >> 32, n - 32);
+        bw_put(bw, v & 0xffffffffull, 32);
+        return;
+    }
+    if (!n) return;
+    bw->acc = (bw->acc << n) | (v & (~0ull >> (64 - n)));
+    bw->nbits += n;
+    while (bw->nbits >= 8)
+    {
+        bw->nbits -= 8;
+        *bw->p++ = (u8)(bw->acc >> bw->nbits);
+    }
+}
+
+// flush the partial byte and pad to a multiple of 8 bytes relative to start, plus 8 bytes of read guard
+inline u8 *
+bw_finish(bit_writer *bw, u8 *start)
+{
+    if (bw->nbits) *bw->p++ = (u8)(bw->acc << (8 - bw->nbits));
+    bw->nbits = 0;
+    while ((bw->p - start) & 7)
+        *bw->p++ = 0;
+    memset(bw->p, 0, 8);
+    return bw->p + 8;
+}
+
+inline u64
+br_get(bit_reader *br, i32 n)
+{
+    if (n > 56)
+    {
+        u64 hi = br_get(br, n - 32);
+        return (hi << 32) | br_get(br, 32);
+    }
+    if (!n) return 0;
+    u64 v;
+    memcpy(&v, br->base + (br->pos >> 3), sizeof(v));
+    v = __builtin_bswap64(v) << (br->pos & 7);
+    br->pos += n;
+    return v >> (64 - n);
+}
+
+// peek a few prefix bits without consuming them
+inline u64
+br_peek(bit_reader *br, i32 n)
+{
+    u64 v;
+    memcpy(&v, br->base + (br->pos >> 3), sizeof(v));
+    v = __builtin_bswap64(v) << (br->pos & 7);
+    return v >> (64 - n);
+}
+
+inline u64
+f64_bits(f64 v)
+{
+    u64 u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+inline f64
+bits_f64(u64 u)
+{
+    f64 v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+// monotone mapping of f64 bits to u64, so numerically close values are close integers
+inline u64
+f64_ordered(u64 u)
+{
+    return (u >> 63) ? ~u : (u | (1ull << 63));
+}
+
+inline u64
+f64_unordered(u64 o)
+{
+    return (o >> 63) ? (o & ~(1ull << 63)) : ~o;
+}
+
+// worst case bytes for n values in either codec, including padding and guard
+inline u64
+codec_bound(u64 n)
+{
+    return (n * 78 + 64 + 7) / 8 + 24;
+}
+
+u8 *
+encode_xor(const f64 *values, u64 n, u8 *out)
+{
+    bit_writer bw = { out, 0, 0 };
+    if (!n) return bw_finish(&bw, out);
+    u64 prev = f64_bits(values[0]);
+    bw_put(&bw, prev, 64);
+    i32 lead_prev = -1;
+    i32 trail_prev = 0;
+    for (u64 i = 1; i < n; i++)
+    {
+        u64 cur = f64_bits(values[i]);
+        u64 x = cur ^ prev;
+        prev = cur;
+        if (!x)
+        {
+            bw_put(&bw, 0, 1);
+            continue;
+        }
+        i32 lead = __builtin_clzll(x);
+        i32 trail = __builtin_ctzll(x);
+        if (lead > 31) lead = 31;
+        if (lead_prev >= 0 && lead >= lead_prev && trail >= trail_prev)
+        {
+            // fits the previous window
+            bw_put(&bw, 2, 2);
+            bw_put(&bw, x >> trail_prev, 64 - lead_prev - trail_prev);
+        }
+        else
+        {
+            i32 sig = 64 - lead - trail;
+            bw_put(&bw, 3, 2);
+            bw_put(&bw, lead, 5);
+            bw_put(&bw, sig - 1, 6);
+            bw_put(&bw, x >> trail, sig);
+            lead_prev = lead;
+            trail_prev = trail;
+        }
+    }
+    return bw_finish(&bw, out);
+}
+
+void
+decode_xor(const u8 *in, u64 n, f64 *values)
+{
+    bit_reader br = { in, 0 };
+    if (!n) return;
+    u64 prev = br_get(&br, 64);
+    values[0] = bits_f64(prev);
+    i32 lead = 0;
+    i32 sig = 64;
+    for (u64 i = 1; i < n; i++)
+    {
+        u64 prefix = br_peek(&br, 2);
+        if (!(prefix & 2))
+        {
+            br.pos += 1;
+        }
+        else
+        {
+            br.pos += 2;
+            if (prefix & 1)
+            {
+                u64 header = br_get(&br, 11);
+                lead = (i32)(header >> 6);
+                sig = (i32)(header & 63) + 1;
+            }
+            prev ^= br_get(&br, sig) << (64 - lead - sig);
+        }
+        values[i] = bits_f64(prev);
+    }
+}
+
+// delta-of-delta over a u64 sequence produced by next(i)
+template <typename F>
+u8 *
+encode_dod_ints(u64 n, u8 *out, F next)
+{
+    bit_writer bw = { out, 0, 0 };
+    if (!n) return bw_finish(&bw, out);
+    u64 prev = next(0);
+    bw_put(&bw, prev, 64);
+    // differences wrap modulo 2^64 (signed ones could overflow on large jumps); the decoder wraps the same way
+    u64 delta_prev = 0;
+    for (u64 i = 1; i < n; i++)
+    {
+        u64 cur = next(i);
+        u64 delta = cur - prev;
+        u64 dod = delta - delta_prev;
+        u64 z = (dod << 1) ^ (0 - (dod >> 63));
+        prev = cur;
+        delta_prev = delta;
+        if (!z)
+        {
+            bw_put(&bw, 0, 1);
+        }
+        else if (z < (1ull << 8))
+        {
+            bw_put(&bw, 2, 2);
+            bw_put(&bw, z, 8);
+        }
+        else if (z < (1ull << 16))
+        {
+            bw_put(&bw, 6, 3);
+            bw_put(&bw, z, 16);
+        }
+        else if (z < (1ull << 32))
+        {
+            bw_put(&bw, 14, 4);
+            bw_put(&bw, z, 32);
+        }
+        else
+        {
+            bw_put(&bw, 15, 4);
+            bw_put(&bw, z, 64);
+        }
+    }
+    return bw_finish(&bw, out);
+}
+
+u8 *
+encode_dod(const f64 *values, u64 n, u8 *out)
+{
+    return encode_dod_ints(n, out, [values](u64 i) { return f64_ordered(f64_bits(values[i])); });
+}
+
+u8 *
+encode_qdod(const f64 *values, u64 n, f64 quantum, u8 *out)
+{
+    return encode_dod_ints(n, out, [values, quantum](u64 i) { return (u64)llround(values[i] / quantum); });
+}
+
+template <typename F>
+void
+decode_dod_ints(const u8 *in, u64 n, F emit)
+{
+    static const i32 prefix_len[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 4 };
+    static const i32 payload_len[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 16, 16, 32, 64 };
+    bit_reader br = { in, 0 };
+    if (!n) return;
+    u64 prev = br_get(&br, 64);
+    emit(0, prev);
+    u64 delta = 0;
+    for (u64 i = 1; i < n; i++)
+    {
+        u64 prefix = br_peek(&br, 4);
+        br.pos += prefix_len[prefix];
+        u64 z = br_get(&br, payload_len[prefix]);
+        delta += (z >> 1) ^ (0 - (z & 1));
+        prev += delta;
+        emit(i, prev);
+    }
+}
+
+void
+decode_dod(const u8 *in, u64 n, f64 *values)
+{
+    decode_dod_ints(in, n, [values](u64 i, u64 v) { values[i] = bits_f64(f64_unordered(v)); });
+}
+
+void
+decode_qdod(const u8 *in, u64 n, f64 quantum, f64 *values)
+{
+    decode_dod_ints(in, n, [values, quantum](u64 i, u64 v) { values[i] = (f64)(i64)v * quantum; });
+}
+
+// encode with whichever codec is smallest for this column; quantum 0 keeps it lossless. Returns the codec used.
+i32
+encode_column(const f64 *values, u64 n, f64 quantum, u8 *out, u8 *scratch, u64 *bytes)
+{
+    i32 codec = CODEC_XOR;
+    *bytes = encode_xor(values, n, out) - out;
+    u64 dod_bytes = encode_dod(values, n, scratch) - scratch;
+    if (dod_bytes < *bytes)
+    {
+        memcpy(out, scratch, dod_bytes);
+        *bytes = dod_bytes;
+        codec = CODEC_DOD;
+    }
+
+    bool quantizable = quantum > 0;
+    for (u64 i = 0; quantizable && i < n; i++)
+        quantizable = fabs(values[i] / quantum) < 4e18;
+    if (quantizable)
+    {
+        u64 qdod_bytes = encode_qdod(values, n, quantum, scratch) - scratch;
+        if (qdod_bytes < *bytes)
+        {
+            memcpy(out, scratch, qdod_bytes);
+            *bytes = qdod_bytes;
+            codec = CODEC_QDOD;
+        }
+    }
+    return codec;
+}
+
+void
+decode_column(i32 codec, const u8 *in, u64 n, f64 quantum, f64 *values)
+{
+    if (codec == CODEC_QDOD)
+        decode_qdod(in, n, quantum, values);
+    else if (codec == CODEC_DOD)
+        decode_dod(in, n, values);
+    else
+        decode_xor(in, n, values);
+}
@@ -0,0 +1,167 @@
+#include "base.hpp"
+#include "vecenv.h"
+#include <algorithm>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// --verify-determinism [N]: evidence that results do not depend on scheduling. Each scenario runs N vectorized
+// environments for DETERMINISM_STEPS steps, once serially as the reference, once more serially, then on thread pools of
+// several sizes (uneven ones included, so the per-thread ranges move), and finally all scenarios at once on their own
+// threads, which catches state shared between environments. After every step qpos, qvel and ctrl of every environment
+// are hashed; a run that differs from the reference is reported at its first divergent step, environment and field.
+
+#define DETERMINISM_STEPS 1000
+
+enum determinism_field
+{
+    DETERMINISM_QPOS,
+    DETERMINISM_QVEL,
+    DETERMINISM_CTRL,
+    DETERMINISM_FIELDS,
+};
+
+const char *determinism_field_names[DETERMINISM_FIELDS] = { "qpos", "qvel", "ctrl" };
+
+typedef struct determinism_scenario {
+    const char *name;
+    bool lqr; // LQR policy, or no force at all so the poles fall and reset
+    f64 disturbance;
+    f64 obs_noise;
+} determinism_scenario;
+
+const determinism_scenario determinism_scenarios[] = {
+    { "lqr", true, 0.0, 0.0 },
+    { "lqr, disturbance, noise", true, 20.0, 0.01 },
+    { "open loop, resets", false, 0.0, 0.0 },
+};
+const i32 determinism_nscenarios = sizeof(determinism_scenarios) / sizeof(determinism_scenarios[0]);
+
+typedef struct determinism_run {
+    const determinism_scenario *scenario;
+    i32 threads;
+    std::vector<u64> trace; // [step][env][field]
+    bool ok;
+} determinism_run;
+
+i32 verify_determinism(i32 n, const char *scene_path);
+
+// one scenario on a pool of threads, hashing every environment after every step into run->trace
+void
+determinism_trace(determinism_run *run, i32 n, const char *scene_path)
+{
+    const determinism_scenario *sc = run->scenario;
+    vecenv_config config;
+    vecenv_default_config(&config);
+    config.threads = run->threads;
+    config.seed = 1;
+    config.max_time = 2.0; // time-limit resets as well as falls
+    config.disturbance = sc->disturbance;
+    config.obs_noise = sc->obs_noise;
+    config.scene_path = scene_path;
+    vecenv *env = vecenv_create(n, &config);
+    run->ok = env != NULL;
+    if (!env) return;
+
+    std::vector<f64> obs(n * VECENV_OBS_DIM), actions(n * VECENV_ACT_DIM), reward(n);
+    std::vector<u8> done(n);
+    run->trace.resize((size_t)DETERMINISM_STEPS * n * DETERMINISM_FIELDS);
+    const mjModel *m = env->w.model;
+    vecenv_reset(env, NULL, obs.data());
+    for (i32 s = 0; s < DETERMINISM_STEPS; s++)
+    {
+        if (sc->lqr) vecenv_lqr_actions(env, obs.data(), actions.data());
+        vecenv_step(env, actions.data(), obs.data(), reward.data(), done.data(), NULL);
+        for (i32 i = 0; i < n; i++)
+        {
+            const mjData *d = env->data[i];
+            u64 *h = &run->trace[((size_t)s * n + i) * DETERMINISM_FIELDS];
+            h[DETERMINISM_QPOS] = hash_bytes(d->qpos, m->nq * sizeof(mjtNum), HASH_SEED);
+            h[DETERMINISM_QVEL] = hash_bytes(d->qvel, m->nv * sizeof(mjtNum), HASH_SEED);
+            h[DETERMINISM_CTRL] = hash_bytes(d->ctrl, m->nu * sizeof(mjtNum), HASH_SEED);
+        }
+    }
+    vecenv_destroy(env);
+}
+
+// prints the row for run against the reference; false when they differ
+bool
+determinism_compare(const determinism_run *reference, const determinism_run *run, i32 n, const char *label)
+{
+    printf("%-26s %-14s ", run->scenario->name, label);
+    if (!run->ok)
+    {
+        printf("failed to create the environments\n");
+        return false;
+    }
+    for (size_t k = 0; k < run->trace.size(); k++)
+    {
+        if (run->trace[k] == reference->trace[k]) continue;
+        i32 field = (i32)(k % DETERMINISM_FIELDS);
+        i32 env = (i32)(k / DETERMINISM_FIELDS % n);
+        i32 step = (i32)(k / DETERMINISM_FIELDS / n);
+        printf("DIVERGED at step %d, environment %d, %s\n", step, env, determinism_field_names[field]);
+        return false;
+    }
+    printf("identical\n");
+    return true;
+}
+
+i32
+verify_determinism(i32 n, const char *scene_path)
+{
+    if (n <= 0) n = 64;
+    i32 cores = (i32)std::thread::hardware_concurrency();
+    std::vector<i32> pools = { 2, 3, 4, 7, 16, 64, cores };
+    std::sort(pools.begin(), pools.end());
+    pools.erase(std::unique(pools.begin(), pools.end()), pools.end());
+    pools.erase(std::remove_if(pools.begin(), pools.end(), [&](i32 t) { return t < 2 || t > n; }), pools.end());
+
+    printf("%d environments, %d steps per scenario, qpos/qvel/ctrl hashed after every step\n", n, DETERMINISM_STEPS);
+    printf("%-26s %-14s %s\n", "scenario", "run", "result");
+    bool all = true;
+    std::vector<determinism_run> references(determinism_nscenarios);
+    for (i32 s = 0; s < determinism_nscenarios; s++)
+    {
+        determinism_run *reference = &references[s];
+        reference->scenario = &determinism_scenarios[s];
+        reference->threads = 1;
+        determinism_trace(reference, n, scene_path);
+        if (!reference->ok)
+        {
+            fprintf(stderr, "verify-determinism: cannot create the environments\n");
+            return 1;
+        }
+
+        determinism_run run;
+        run.scenario = reference->scenario;
+        run.threads = 1;
+        determinism_trace(&run, n, scene_path);
+        all = determinism_compare(reference, &run, n, "serial again") && all;
+        for (i32 threads : pools)
+        {
+            run.threads = threads;
+            determinism_trace(&run, n, scene_path);
+            char label[32];
+            snprintf(label, sizeof(label), "%d threads", threads);
+            all = determinism_compare(reference, &run, n, label) && all;
+        }
+    }
+
+    // every scenario at the same time, each on its own pool
+    std::vector<determinism_run> concurrent(determinism_nscenarios);
+    std::vector<std::thread> threads;
+    for (i32 s = 0; s < determinism_nscenarios; s++)
+    {
+        concurrent[s].scenario = &determinism_scenarios[s];
+        concurrent[s].threads = mjMAX(2, mjMIN(cores, n));
+        threads.emplace_back(determinism_trace, &concurrent[s], n, scene_path);
+    }
+    for (std::thread &t : threads)
+        t.join();
+    for (i32 s = 0; s < determinism_nscenarios; s++)
+        all = determinism_compare(&references[s], &concurrent[s], n, "concurrent") && all;
+
+    printf(all ? "deterministic: every run matched its serial reference\n" : "NOT deterministic\n");
+    return all ? 0 : 1;
+}
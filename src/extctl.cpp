@@ -0,0 +1,336 @@
+#include "base.hpp"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Out-of-process controllers over POSIX shared memory (--ext-control NAME). The segment holds two single-producer
+// single-consumer rings: states from the simulator to the controller and actions back. On every control period the
+// simulator publishes the state, wakes the controller through a futex on the ring's signal word and waits on the action
+// ring's futex until an action with the same sequence number arrives or the deadline passes; a miss, or no controller
+// attached, applies the built-in LQR instead. Actions that arrive late are discarded by sequence number. Every
+// exchange's round trip is kept for the panel. --ext-client NAME is a reference controller that applies u = -Kx with
+// the K sent along with the state. Without futexes (macOS) both sides poll.
+
+#define EXT_MAGIC 0x4d50435452ull // "MPCTR"
+#define EXT_VERSION 1
+#define EXT_RING_SIZE 64
+#define EXT_RTT_SAMPLES 1024
+#define EXT_POLL_NS 20000
+
+typedef struct ext_state_msg {
+    u64 seq;
+    f64 time;
+    f64 x[nstate];
+    f64 y[nstate];
+    f64 K[nstate]; // the simulator's gain, for controllers that want to start from it
+} ext_state_msg;
+
+typedef struct ext_action_msg {
+    u64 seq; // of the state it answers
+    f64 ux;
+    f64 uy;
+} ext_action_msg;
+
+template <typename T> struct ext_ring {
+    alignas(64) std::atomic<u64> head; // producer
+    alignas(64) std::atomic<u64> tail; // consumer
+    alignas(64) std::atomic<u32> signal; // bumped on every push; the futex word
+    std::atomic<u32> waiting;            // consumer is (about to be) asleep on signal
+    T slots[EXT_RING_SIZE];
+};
+
+typedef struct ext_shm {
+    u64 magic;
+    u32 version;
+    std::atomic<i32> server_pid; // 0 once the simulator has left
+    std::atomic<i32> client_pid; // 0 when no controller is attached
+    ext_ring<ext_state_msg> states;
+    ext_ring<ext_action_msg> actions;
+} ext_shm;
+
+typedef struct ext_link {
+    char name[80];
+    ext_shm *shm;
+    u64 seq;
+    u64 exchanges;
+    u64 misses;
+    u64 late; // actions that arrived after their deadline, also counted as misses
+    i64 rtt_ns[EXT_RTT_SAMPLES];
+    u64 rtt_count;
+    i64 rtt_max_ns;
+    i64 next_check_ns;
+    bool attached;
+} ext_link;
+
+void init_ext(world *w);
+void destroy_ext(world *w);
+void ext_control(world *w);
+i64 ext_rtt_percentile(world *w, f64 p);
+i32 ext_client(const char *name);
+
+void
+ext_futex_wait(std::atomic<u32> *word, u32 expected, i64 timeout_ns)
+{
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec = timeout_ns / 1000000000;
+    ts.tv_nsec = timeout_ns % 1000000000;
+    syscall(SYS_futex, (u32 *)word, FUTEX_WAIT, expected, &ts, NULL, 0);
+#else
+    (void)word;
+    (void)expected;
+    sleep_until_ns(now_ns() + mjMIN(timeout_ns, (i64)EXT_POLL_NS));
+#endif
+}
+
+void
+ext_futex_wake(std::atomic<u32> *word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (u32 *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+// false when the ring is full
+template <typename T>
+bool
+ext_push(ext_ring<T> *r, const T *v)
+{
+    u64 head = r->head.load(std::memory_order_relaxed);
+    if (head - r->tail.load(std::memory_order_acquire) == EXT_RING_SIZE) return false;
+    r->slots[head % EXT_RING_SIZE] = *v;
+    r->head.store(head + 1, std::memory_order_release);
+    r->signal.fetch_add(1);
+    if (r->waiting.load()) ext_futex_wake(&r->signal);
+    return true;
+}
+
+template <typename T>
+bool
+ext_pop(ext_ring<T> *r, T *v)
+{
+    u64 tail = r->tail.load(std::memory_order_relaxed);
+    if (tail == r->head.load(std::memory_order_acquire)) return false;
+    *v = r->slots[tail % EXT_RING_SIZE];
+    r->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// pop one message, sleeping up to timeout_ns for it; false on timeout
+template <typename T>
+bool
+ext_pop_wait(ext_ring<T> *r, T *v, i64 timeout_ns)
+{
+    i64 deadline = now_ns() + timeout_ns;
+    for (;;)
+    {
+        u32 seen = r->signal.load();
+        if (ext_pop(r, v)) return true;
+        i64 left = deadline - now_ns();
+        if (left <= 0) return false;
+        r->waiting.store(1);
+        if (r->signal.load() == seen) ext_futex_wait(&r->signal, seen, left);
+        r->waiting.store(0);
+    }
+}
+
+void
+init_ext(world *w)
+{
+    if (!w->ext_name[0]) return;
+    ext_link *e = new ext_link();
+    snprintf(e->name, sizeof(e->name), "%s%s", w->ext_name[0] == '/' ? "" : "/", w->ext_name);
+    i32 fd = shm_open(e->name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(ext_shm)) != 0)
+    {
+        fprintf(stderr, "ext: cannot create shared memory %s (%s), using the built-in controller\n", e->name, strerror(errno));
+        if (fd >= 0) close(fd);
+        delete e;
+        return;
+    }
+    void *p = mmap(NULL, sizeof(ext_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        fprintf(stderr, "ext: cannot map %s (%s), using the built-in controller\n", e->name, strerror(errno));
+        shm_unlink(e->name);
+        delete e;
+        return;
+    }
+    e->shm = new (p) ext_shm();
+    e->shm->magic = EXT_MAGIC;
+    e->shm->version = EXT_VERSION;
+    e->shm->server_pid.store((i32)getpid());
+    w->ext = e;
+    printf("ext: waiting for a controller on %s (deadline %d us)\n", e->name, w->ext_deadline_us);
+}
+
+void
+destroy_ext(world *w)
+{
+    ext_link *e = w->ext;
+    if (!e) return;
+    e->shm->server_pid.store(0);
+    ext_futex_wake(&e->shm->states.signal);
+    munmap(e->shm, sizeof(ext_shm));
+    shm_unlink(e->name);
+    printf("ext: %llu exchanges, %llu deadline misses, %llu late actions, rtt p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           (unsigned long long)e->exchanges, (unsigned long long)e->misses, (unsigned long long)e->late, ext_rtt_percentile(w, 0.5) / 1e3,
+           ext_rtt_percentile(w, 0.99) / 1e3, e->rtt_max_ns / 1e3);
+    delete e;
+    w->ext = NULL;
+}
+
+// round trip over the last EXT_RTT_SAMPLES exchanges
+i64
+ext_rtt_percentile(world *w, f64 p)
+{
+    ext_link *e = w->ext;
+    i32 n = (i32)mjMIN(e->rtt_count, (u64)EXT_RTT_SAMPLES);
+    if (!n) return 0;
+    i64 sorted[EXT_RTT_SAMPLES];
+    memcpy(sorted, e->rtt_ns, n * sizeof(i64));
+    i32 k = mjMIN(n - 1, (i32)(p * n));
+    std::nth_element(sorted, sorted + k, sorted + n);
+    return sorted[k];
+}
+
+// one control period: the external controller's action if it answers in time, the LQR law otherwise
+void
+ext_control(world *w)
+{
+    ext_link *e = w->ext;
+    ext_shm *shm = e->shm;
+    i64 now = now_ns();
+    i32 pid = shm->client_pid.load();
+    if (now >= e->next_check_ns)
+    {
+        // a controller that died without detaching
+        if (pid && kill(pid, 0) != 0 && errno == ESRCH) shm->client_pid.compare_exchange_strong(pid, 0);
+        e->next_check_ns = now + 1000000000;
+    }
+    e->attached = shm->client_pid.load() != 0;
+    control(w);
+    if (!e->attached) return;
+
+    ext_state_msg s;
+    s.seq = ++e->seq;
+    s.time = w->data->time;
+    for (i32 k = 0; k < nstate; k++)
+    {
+        s.x[k] = w->x(k);
+        s.y[k] = w->y(k);
+        s.K[k] = w->K(0, k);
+    }
+    i64 sent = now_ns();
+    if (!ext_push(&shm->states, &s))
+    {
+        e->misses++;
+        return;
+    }
+
+    i64 deadline = sent + (i64)w->ext_deadline_us * 1000;
+    ext_action_msg a;
+    for (;;)
+    {
+        if (!ext_pop_wait(&shm->actions, &a, deadline - now_ns()))
+        {
+            e->misses++;
+            return;
+        }
+        if (a.seq == s.seq) break;
+        e->late++;
+    }
+    i64 received = now_ns();
+    i64 rtt = received - sent;
+    e->rtt_ns[e->rtt_count++ % EXT_RTT_SAMPLES] = rtt;
+    e->rtt_max_ns = mjMAX(e->rtt_max_ns, rtt);
+    e->exchanges++;
+    if (received > deadline)
+    {
+        // the wait overslept the deadline; the answer is in but too late to use
+        e->late++;
+        e->misses++;
+        return;
+    }
+    w->ux = a.ux;
+    w->uy = a.uy;
+    w->data->ctrl[0] = w->ux;
+    w->data->ctrl[1] = w->uy;
+}
+
+static volatile sig_atomic_t ext_client_stop;
+
+void
+ext_client_signal(i32)
+{
+    ext_client_stop = 1;
+}
+
+// --ext-client: reference controller, u = -Kx with the simulator's K; returns a process exit code
+i32
+ext_client(const char *name)
+{
+    char path[80];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+    i32 fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ext client: no simulator on %s (%s)\n", path, strerror(errno));
+        return 1;
+    }
+    void *p = mmap(NULL, sizeof(ext_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ext_shm *shm = (ext_shm *)p;
+    if (p == MAP_FAILED || shm->magic != EXT_MAGIC || shm->version != EXT_VERSION)
+    {
+        fprintf(stderr, "ext client: %s is not a controller segment of this version\n", path);
+        return 1;
+    }
+    i32 none = 0;
+    if (!shm->client_pid.compare_exchange_strong(none, (i32)getpid()))
+    {
+        fprintf(stderr, "ext client: another controller (pid %d) is attached\n", none);
+        return 1;
+    }
+    signal(SIGINT, ext_client_signal);
+    signal(SIGTERM, ext_client_signal);
+    printf("ext client: attached to %s\n", path);
+
+    // drop whatever queued up before we attached
+    ext_state_msg s;
+    while (ext_pop(&shm->states, &s))
+        ;
+    u64 served = 0;
+    while (!ext_client_stop && shm->server_pid.load())
+    {
+        if (!ext_pop_wait(&shm->states, &s, 100000000)) continue;
+        ext_action_msg a;
+        a.seq = s.seq;
+        a.ux = 0.0;
+        a.uy = 0.0;
+        for (i32 k = 0; k < nstate; k++)
+        {
+            a.ux -= s.K[k] * s.x[k];
+            a.uy -= s.K[k] * s.y[k];
+        }
+        ext_push(&shm->actions, &a);
+        served++;
+    }
+    shm->client_pid.store(0);
+    munmap(p, sizeof(ext_shm));
+    printf("ext client: served %llu states\n", (unsigned long long)served);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "base.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A fleet of extra pendulums for visualization and stress tests (--fleet N): N mjData on the one shared mjModel, driven
+// by the same K at the same control rate as the main pendulum. The controller state is kept as structure of arrays,
+// x[k * n + i] being state component k of pendulum i, so the control law walks contiguous memory however large N gets.
+// The pendulums are drawn on a grid next to the main one by adding their dynamic geoms to the scene at an offset, and
+// one that tips over is restarted from a random tilt. With a gain spread the pendulums get K scaled linearly from
+// (1 - spread) to (1 + spread) across the fleet, a gain sweep that shows which margin still balances.
+
+#define FLEET_SPACING 1.0
+#define FLEET_START_ANGLE (mjPI / 12)
+#define FLEET_FALL_ANGLE 1.0
+#define FLEET_ALIGN 64
+
+typedef struct fleet_state {
+    i32 n;
+    mjData **data;
+    // structure of arrays, 64-byte aligned
+    f64 *x; // nstate * n
+    f64 *y; // nstate * n
+    f64 *ux; // n
+    f64 *uy; // n
+    f64 *K;  // nstate * n, per-pendulum gains when spread
+    u32 *episode; // resets of each pendulum, for its random tilt; pendulum i is environment i + 1 of the seed
+    f64 K_from[nstate]; // w->K and spread that K was built for
+    f32 K_spread;
+    i32 columns;
+    u64 falls;
+    f64 step_ns; // smoothed cost of stepping the whole fleet once
+    f64 control_ns; // smoothed cost of the batched control law
+} fleet_state;
+
+void init_fleet(world *w);
+void destroy_fleet(world *w);
+void fleet_reset(world *w, i32 i);
+void fleet_reset_all(world *w);
+void fleet_gather(world *w);
+void fleet_control(world *w);
+void fleet_step(world *w);
+void fleet_add_geoms(world *w);
+i32 scene_max_geoms(const world *w);
+
+f64 *
+fleet_array(i32 count)
+{
+    size_t size = ((count * sizeof(f64) + FLEET_ALIGN - 1) / FLEET_ALIGN) * FLEET_ALIGN;
+    f64 *a = (f64 *)aligned_alloc(FLEET_ALIGN, mjMAX(size, (size_t)FLEET_ALIGN));
+    memset(a, 0, size);
+    return a;
+}
+
+void
+init_fleet(world *w)
+{
+    if (w->fleet_size <= 0) return;
+    fleet_state *f = new fleet_state();
+    f->n = w->fleet_size;
+    f->data = (mjData **)calloc(f->n, sizeof(mjData *));
+    for (i32 i = 0; i < f->n; i++)
+        f->data[i] = mj_makeData(w->model);
+    f->x = fleet_array(nstate * f->n);
+    f->y = fleet_array(nstate * f->n);
+    f->ux = fleet_array(f->n);
+    f->uy = fleet_array(f->n);
+    f->K = fleet_array(nstate * f->n);
+    f->episode = (u32 *)calloc(f->n, sizeof(u32));
+    f->K_spread = -1.0f; // built on first use
+    // the main pendulum takes the first cell
+    f->columns = (i32)ceil(sqrt((f64)f->n + 1));
+    w->fleet = f;
+    fleet_reset_all(w);
+}
+
+void
+destroy_fleet(world *w)
+{
+    fleet_state *f = w->fleet;
+    if (!f) return;
+    for (i32 i = 0; i < f->n; i++)
+        mj_deleteData(f->data[i]);
+    free(f->data);
+    free(f->x);
+    free(f->y);
+    free(f->ux);
+    free(f->uy);
+    free(f->K);
+    free(f->episode);
+    delete f;
+    w->fleet = NULL;
+}
+
+// back to the model's initial state with a random tilt
+void
+fleet_reset(world *w, i32 i)
+{
+    mjData *d = w->fleet->data[i];
+    rng_stream rng = rng_open(w->seed, i + 1, w->fleet->episode[i]++, RNG_INITIAL_STATE);
+    mj_resetData(w->model, d);
+    d->qpos[w->hinge_x_qpos_id] = rng_symmetric(&rng) * FLEET_START_ANGLE;
+    d->qpos[w->hinge_y_qpos_id] = rng_symmetric(&rng) * FLEET_START_ANGLE;
+    mj_forward(w->model, d);
+}
+
+void
+fleet_reset_all(world *w)
+{
+    if (!w->fleet) return;
+    for (i32 i = 0; i < w->fleet->n; i++)
+        fleet_reset(w, i);
+}
+
+// state of every pendulum into the SoA arrays
+void
+fleet_gather(world *w)
+{
+    fleet_state *f = w->fleet;
+    const i32 n = f->n;
+    for (i32 i = 0; i < n; i++)
+    {
+        Eigen::Matrix<f64, nstate, 1> x;
+        Eigen::Matrix<f64, nstate, 1> y;
+        read_state_from_data(w, f->data[i], x, y);
+        for (i32 k = 0; k < nstate; k++)
+        {
+            f->x[k * n + i] = x(k);
+            f->y[k * n + i] = y(k);
+        }
+    }
+}
+
+// per-pendulum gains for the current K and spread, rebuilt only when either changed
+void
+fleet_update_gains(world *w)
+{
+    fleet_state *f = w->fleet;
+    const i32 n = f->n;
+    bool same = f->K_spread == w->fleet_gain_spread;
+    for (i32 k = 0; k < nstate; k++)
+        same &= f->K_from[k] == w->K(0, k);
+    if (same) return;
+    for (i32 k = 0; k < nstate; k++)
+    {
+        f->K_from[k] = w->K(0, k);
+        for (i32 i = 0; i < n; i++)
+        {
+            f64 scale = 1.0 + w->fleet_gain_spread * (n > 1 ? 2.0 * i / (n - 1) - 1.0 : 0.0);
+            f->K[k * n + i] = scale * w->K(0, k);
+        }
+    }
+    f->K_spread = w->fleet_gain_spread;
+}
+
+// u = -K x for the whole fleet with the batched kernels
+void
+fleet_control(world *w)
+{
+    fleet_state *f = w->fleet;
+    if (!f) return;
+    const i32 n = f->n;
+    fleet_gather(w);
+    i64 start = now_ns();
+    bool per_env = w->fleet_gain_spread != 0.0f;
+    if (per_env) fleet_update_gains(w);
+    const f64 *K = per_env ? f->K : w->K.data();
+    batch_control(K, per_env, f->x, f->ux, n);
+    batch_control(K, per_env, f->y, f->uy, n);
+    f64 cost = (f64)(now_ns() - start);
+    f->control_ns = f->control_ns > 0 ? 0.9 * f->control_ns + 0.1 * cost : cost;
+    for (i32 i = 0; i < n; i++)
+    {
+        f->data[i]->ctrl[0] = f->ux[i];
+        f->data[i]->ctrl[1] = f->uy[i];
+    }
+}
+
+// one physics step for every pendulum, restarting the ones that fell
+void
+fleet_step(world *w)
+{
+    fleet_state *f = w->fleet;
+    if (!f) return;
+    i64 start = now_ns();
+    for (i32 i = 0; i < f->n; i++)
+    {
+        mjData *d = f->data[i];
+        mj_step(w->model, d);
+        if (fabs(d->qpos[w->hinge_x_qpos_id]) > FLEET_FALL_ANGLE || fabs(d->qpos[w->hinge_y_qpos_id]) > FLEET_FALL_ANGLE)
+        {
+            fleet_reset(w, i);
+            f->falls++;
+        }
+    }
+    f64 cost = (f64)(now_ns() - start);
+    f->step_ns = f->step_ns > 0 ? 0.9 * f->step_ns + 0.1 * cost : cost;
+}
+
+// dynamic geoms of every pendulum into the scene, each shifted to its grid cell
+void
+fleet_add_geoms(world *w)
+{
+    fleet_state *f = w->fleet;
+    if (!f) return;
+    mjvScene *scene = &w->scene;
+    for (i32 i = 0; i < f->n; i++)
+    {
+        i32 first = scene->ngeom;
+        mjv_addGeoms(w->model, f->data[i], &w->opt, NULL, mjCAT_DYNAMIC, scene);
+        i32 cell = i + 1;
+        f32 dx = (f32)((cell % f->columns) * FLEET_SPACING);
+        f32 dy = (f32)((cell / f->columns) * FLEET_SPACING);
+        for (i32 g = first; g < scene->ngeom; g++)
+        {
+            scene->geoms[g].pos[0] += dx;
+            scene->geoms[g].pos[1] += dy;
+        }
+    }
+}
+
+// room for the fleet's geoms on top of the main scene
+i32
+scene_max_geoms(const world *w)
+{
+    return 2000 + mjMAX(w->fleet_size, 0) * w->model->ngeom;
+}
@@ -0,0 +1,217 @@
+#include "base.hpp"
+#include <math.h>
+
+// Frequency response of the LQR loop broken at the plant input, L(jw) = K (jwI - A)^-1 B, on a log grid. A is reduced
+// once to Hessenberg form A = U H U^T (redone only when A changes), so each frequency is one solve of the Hessenberg
+// system (jwI - H) z = U^T B followed by L = (K U) z. The solves run in lockstep over chunks of frequencies with the
+// complex values split into real/imaginary arrays, so the inner loops run over frequencies and vectorize; the row swap
+// of the adjacent-row pivoting is a per-frequency select rather than a branch.
+
+#define FREQ_POINTS 4096
+#define FREQ_CHUNK 64
+#define FREQ_MIN_OMEGA 1e-2
+#define FREQ_MAX_OMEGA 1e3
+
+typedef struct freq_response {
+    u64 a_hash;
+    u64 loop_hash;
+    Eigen::Matrix<f64, nstate, nstate> H;
+    Eigen::Matrix<f64, nstate, nstate> U;
+
+    f64 omega[FREQ_POINTS];
+    f64 re[FREQ_POINTS]; // L(jw)
+    f64 im[FREQ_POINTS];
+    f64 mag_db[FREQ_POINTS];
+    f64 phase_deg[FREQ_POINTS]; // unwrapped
+
+    f64 gain_margin_db; // INFINITY when the phase never crosses -180
+    f64 gain_margin_omega;
+    f64 phase_margin_deg; // INFINITY when |L| never crosses 1
+    f64 phase_margin_omega;
+    f64 elapsed_ms;
+} freq_response;
+
+void init_freq(world *w);
+void destroy_freq(world *w);
+bool freq_update(world *w);
+
+void
+init_freq(world *w)
+{
+    freq_response *f = new freq_response();
+    for (i32 i = 0; i < FREQ_POINTS; i++)
+        f->omega[i] = FREQ_MIN_OMEGA * pow(FREQ_MAX_OMEGA / FREQ_MIN_OMEGA, (f64)i / (FREQ_POINTS - 1));
+    w->freq = f;
+}
+
+void
+destroy_freq(world *w)
+{
+    delete w->freq;
+    w->freq = NULL;
+}
+
+// L(jw) for FREQ_CHUNK frequencies starting at omega
+void
+freq_solve_chunk(const freq_response *f, const f64 *c, const f64 *b, const f64 *omega, f64 *out_re, f64 *out_im)
+{
+    const i32 n = nstate;
+    const i32 m = FREQ_CHUNK;
+    // M = jwI - H, upper Hessenberg; row i only uses columns >= i - 1
+    f64 mr[n][n][m];
+    f64 mi[n][n][m];
+    f64 zr[n][m];
+    f64 zi[n][m];
+    for (i32 i = 0; i < n; i++)
+    {
+        for (i32 j = 0; j < n; j++)
+            for (i32 k = 0; k < m; k++)
+            {
+                mr[i][j][k] = -f->H(i, j);
+                mi[i][j][k] = i == j ? omega[k] : 0.0;
+            }
+        for (i32 k = 0; k < m; k++)
+        {
+            zr[i][k] = b[i];
+            zi[i][k] = 0.0;
+        }
+    }
+
+    // eliminate the subdiagonal, swapping rows r and r + 1 where the subdiagonal entry is the larger pivot
+    for (i32 r = 0; r + 1 < n; r++)
+    {
+        for (i32 k = 0; k < m; k++)
+        {
+            f64 top = mr[r][r][k] * mr[r][r][k] + mi[r][r][k] * mi[r][r][k];
+            f64 low = mr[r + 1][r][k] * mr[r + 1][r][k] + mi[r + 1][r][k] * mi[r + 1][r][k];
+            bool swap = low > top;
+            for (i32 j = r; j < n; j++)
+            {
+                f64 ar = mr[r][j][k], ai = mi[r][j][k];
+                f64 br = mr[r + 1][j][k], bi = mi[r + 1][j][k];
+                mr[r][j][k] = swap ? br : ar;
+                mi[r][j][k] = swap ? bi : ai;
+                mr[r + 1][j][k] = swap ? ar : br;
+                mi[r + 1][j][k] = swap ? ai : bi;
+            }
+            f64 ar = zr[r][k], ai = zi[r][k];
+            f64 br = zr[r + 1][k], bi = zi[r + 1][k];
+            zr[r][k] = swap ? br : ar;
+            zi[r][k] = swap ? bi : ai;
+            zr[r + 1][k] = swap ? ar : br;
+            zi[r + 1][k] = swap ? ai : bi;
+        }
+        for (i32 k = 0; k < m; k++)
+        {
+            // l = M[r+1][r] / M[r][r]
+            f64 pr = mr[r][r][k], pi = mi[r][r][k];
+            f64 inv = 1.0 / (pr * pr + pi * pi);
+            f64 sr = mr[r + 1][r][k], si = mi[r + 1][r][k];
+            f64 lr = (sr * pr + si * pi) * inv;
+            f64 li = (si * pr - sr * pi) * inv;
+            for (i32 j = r + 1; j < n; j++)
+            {
+                mr[r + 1][j][k] -= lr * mr[r][j][k] - li * mi[r][j][k];
+                mi[r + 1][j][k] -= lr * mi[r][j][k] + li * mr[r][j][k];
+            }
+            zr[r + 1][k] -= lr * zr[r][k] - li * zi[r][k];
+            zi[r + 1][k] -= lr * zi[r][k] + li * zr[r][k];
+        }
+    }
+
+    // back substitution, then L = c . z
+    for (i32 k = 0; k < m; k++)
+    {
+        out_re[k] = 0.0;
+        out_im[k] = 0.0;
+    }
+    for (i32 i = n - 1; i >= 0; i--)
+    {
+        for (i32 k = 0; k < m; k++)
+        {
+            f64 sr = zr[i][k], si = zi[i][k];
+            for (i32 j = i + 1; j < n; j++)
+            {
+                sr -= mr[i][j][k] * zr[j][k] - mi[i][j][k] * zi[j][k];
+                si -= mr[i][j][k] * zi[j][k] + mi[i][j][k] * zr[j][k];
+            }
+            f64 pr = mr[i][i][k], pi = mi[i][i][k];
+            f64 inv = 1.0 / (pr * pr + pi * pi);
+            zr[i][k] = (sr * pr + si * pi) * inv;
+            zi[i][k] = (si * pr - sr * pi) * inv;
+            out_re[k] += c[i] * zr[i][k];
+            out_im[k] += c[i] * zi[i][k];
+        }
+    }
+}
+
+// recompute the response if A, B or K changed since the last call; returns whether it did
+bool
+freq_update(world *w)
+{
+    freq_response *f = w->freq;
+    u64 a_hash = hash_bytes(w->A.data(), sizeof(f64) * w->A.size(), HASH_SEED);
+    u64 loop_hash = hash_bytes(w->B.data(), sizeof(f64) * w->B.size(), a_hash);
+    loop_hash = hash_bytes(w->K.data(), sizeof(f64) * w->K.size(), loop_hash);
+    if (loop_hash == f->loop_hash) return false;
+
+    i64 start = now_ns();
+    if (a_hash != f->a_hash)
+    {
+        Eigen::HessenbergDecomposition<Eigen::Matrix<f64, nstate, nstate> > hd(w->A);
+        f->H = hd.matrixH();
+        f->U = hd.matrixQ();
+        f->a_hash = a_hash;
+    }
+    f->loop_hash = loop_hash;
+
+    Eigen::Matrix<f64, 1, nstate> c = w->K * f->U;
+    Eigen::Matrix<f64, nstate, 1> b = f->U.transpose() * w->B;
+    for (i32 i = 0; i < FREQ_POINTS; i += FREQ_CHUNK)
+        freq_solve_chunk(f, c.data(), b.data(), f->omega + i, f->re + i, f->im + i);
+
+    f->gain_margin_db = INFINITY;
+    f->phase_margin_deg = INFINITY;
+    f->gain_margin_omega = 0.0;
+    f->phase_margin_omega = 0.0;
+    for (i32 i = 0; i < FREQ_POINTS; i++)
+    {
+        f->mag_db[i] = 10.0 * log10(f->re[i] * f->re[i] + f->im[i] * f->im[i]);
+        f64 phase = atan2(f->im[i], f->re[i]) * 180.0 / mjPI;
+        if (i) phase += 360.0 * round((f->phase_deg[i - 1] - phase) / 360.0);
+        f->phase_deg[i] = phase;
+        if (!i) continue;
+
+        // crossings by linear interpolation in log frequency; keep the one closest to instability
+        f64 lw0 = log(f->omega[i - 1]);
+        f64 lw1 = log(f->omega[i]);
+        f64 m0 = f->mag_db[i - 1];
+        f64 m1 = f->mag_db[i];
+        if ((m0 >= 0) != (m1 >= 0))
+        {
+            f64 a = m0 / (m0 - m1);
+            f64 p = f->phase_deg[i - 1] + a * (f->phase_deg[i] - f->phase_deg[i - 1]);
+            f64 margin = remainder(p + 180.0, 360.0);
+            if (fabs(margin) < fabs(f->phase_margin_deg))
+            {
+                f->phase_margin_deg = margin;
+                f->phase_margin_omega = exp(lw0 + a * (lw1 - lw0));
+            }
+        }
+        f64 p0 = f->phase_deg[i - 1] + 180.0;
+        f64 p1 = f->phase_deg[i] + 180.0;
+        f64 turn = 360.0 * floor(mjMAX(p0, p1) / 360.0); // phase + 180 crossing a multiple of 360
+        if (turn > mjMIN(p0, p1) && turn <= mjMAX(p0, p1))
+        {
+            f64 a = (turn - p0) / (p1 - p0);
+            f64 margin = -(m0 + a * (m1 - m0));
+            if (fabs(margin) < fabs(f->gain_margin_db))
+            {
+                f->gain_margin_db = margin;
+                f->gain_margin_omega = exp(lw0 + a * (lw1 - lw0));
+            }
+        }
+    }
+    f->elapsed_ms = (now_ns() - start) / 1e6;
+    return true;
+}
@@ -0,0 +1,202 @@
+#include "base.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Cache of LQR syntheses: (model hash, diag(Q), R) -> (A, B, P, K). Entries live in a fixed in-memory ring and are
+// appended to <cache_dir>/gains.bin, which is read back at startup for the current model, so a configuration that was
+// ever solved is never linearized or solved again. A lookup returns the exact key when present, otherwise the nearest
+// entry whose weights are all within gain_tolerance (relative), otherwise nothing. Lookups and inserts do not allocate,
+// so they are safe inside the compute_lqr_gain allocation guard.
+//
+// Every access to the file holds an exclusive flock, so launches sharing a cache directory never interleave a reset
+// with an append. A key already in memory is not appended again, and at startup the file is compacted in place to the
+// newest GAIN_FILE_MAX distinct keys of any model.
+
+#define GAIN_MAGIC "MPGAINS"
+#define GAIN_VERSION 1
+#define GAIN_CACHE_MAX 4096
+#define GAIN_FILE_MAX 4096
+
+typedef struct gain_entry {
+    u64 model_hash;
+    f64 q[nstate];
+    f64 R;
+    f64 A[nstate * nstate];
+    f64 B[nstate * nact];
+    f64 P[nstate * nstate];
+    f64 K[nact * nstate];
+} gain_entry;
+
+typedef struct gain_file_header {
+    char magic[8];
+    u32 version;
+    u32 entry_size;
+} gain_file_header;
+
+typedef struct gain_cache {
+    gain_entry entries[GAIN_CACHE_MAX];
+    u64 count; // entries ever inserted; the ring holds the last GAIN_CACHE_MAX
+    i32 fd;
+} gain_cache;
+
+enum gain_source
+{
+    GAIN_SOLVED,
+    GAIN_EXACT,
+    GAIN_NEAREST,
+};
+
+void init_gains(world *w);
+void destroy_gains(world *w);
+const gain_entry *gain_lookup(world *w, const f64 *q, f64 R, bool *exact);
+void gain_insert(world *w, const gain_entry *e);
+
+// model hash, diag(Q) and R, the leading fields of gain_entry
+#define GAIN_KEY_SIZE offsetof(gain_entry, A)
+
+bool
+gain_same_key(const gain_entry *a, const gain_entry *b)
+{
+    return !memcmp(a, b, GAIN_KEY_SIZE);
+}
+
+// the newest occurrence of each key, at most GAIN_FILE_MAX of them, oldest first
+std::vector<gain_entry>
+gain_compact(const std::vector<gain_entry> &all)
+{
+    std::vector<gain_entry> kept;
+    std::unordered_map<u64, size_t> seen; // key hash -> index in kept
+    for (size_t i = all.size(); i-- > 0 && kept.size() < GAIN_FILE_MAX;)
+    {
+        u64 key = hash_bytes(&all[i], GAIN_KEY_SIZE, HASH_SEED);
+        auto it = seen.find(key);
+        if (it != seen.end() && gain_same_key(&kept[it->second], &all[i])) continue;
+        seen[key] = kept.size();
+        kept.push_back(all[i]);
+    }
+    std::reverse(kept.begin(), kept.end());
+    return kept;
+}
+
+void
+init_gains(world *w)
+{
+    gain_cache *gc = new gain_cache();
+    gc->fd = -1;
+    w->gains = gc;
+    if (!w->use_gain_cache) return;
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/gains.bin", w->cache_dir);
+    mkdir(w->cache_dir, 0755);
+    gc->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (gc->fd < 0)
+    {
+        fprintf(stderr, "gain cache: cannot open %s\n", path);
+        return;
+    }
+
+    flock(gc->fd, LOCK_EX);
+    gain_file_header h;
+    bool valid = read(gc->fd, &h, sizeof(h)) == sizeof(h) && !memcmp(h.magic, GAIN_MAGIC, sizeof(GAIN_MAGIC)) &&
+                 h.version == GAIN_VERSION && h.entry_size == sizeof(gain_entry);
+    std::vector<gain_entry> all;
+    gain_entry e;
+    ssize_t n = 0;
+    while (valid && (n = read(gc->fd, &e, sizeof(e))) == sizeof(e))
+        all.push_back(e);
+    std::vector<gain_entry> kept = gain_compact(all);
+
+    // empty, from another format, torn at the end or holding repeats: rewrite it while no one else can append
+    if (!valid || n != 0 || kept.size() != all.size())
+    {
+        gain_file_header fresh = {};
+        memcpy(fresh.magic, GAIN_MAGIC, sizeof(GAIN_MAGIC));
+        fresh.version = GAIN_VERSION;
+        fresh.entry_size = sizeof(gain_entry);
+        size_t bytes = kept.size() * sizeof(gain_entry);
+        bool ok = ftruncate(gc->fd, 0) == 0 && write(gc->fd, &fresh, sizeof(fresh)) == sizeof(fresh);
+        ok = ok && (!bytes || write(gc->fd, kept.data(), bytes) == (ssize_t)bytes);
+        if (!ok) fprintf(stderr, "gain cache: cannot rewrite %s\n", path);
+    }
+    flock(gc->fd, LOCK_UN);
+
+    for (const gain_entry &k : kept)
+    {
+        if (k.model_hash != w->model_hash) continue;
+        gc->entries[gc->count % GAIN_CACHE_MAX] = k;
+        gc->count++;
+    }
+}
+
+void
+destroy_gains(world *w)
+{
+    if (!w->gains) return;
+    if (w->gains->fd >= 0) close(w->gains->fd);
+    delete w->gains;
+    w->gains = NULL;
+}
+
+// largest relative difference over the weights
+f64
+gain_distance(const gain_entry *e, const f64 *q, f64 R)
+{
+    f64 d = fabs(e->R - R) / mjMAX(1e-12, mjMAX(fabs(e->R), fabs(R)));
+    for (i32 i = 0; i < nstate; i++)
+        d = mjMAX(d, fabs(e->q[i] - q[i]) / mjMAX(1e-12, mjMAX(fabs(e->q[i]), fabs(q[i]))));
+    return d;
+}
+
+const gain_entry *
+gain_lookup(world *w, const f64 *q, f64 R, bool *exact)
+{
+    gain_cache *gc = w->gains;
+    if (!gc || !w->use_gain_cache) return NULL;
+    const gain_entry *best = NULL;
+    f64 best_distance = w->gain_tolerance;
+    u64 n = mjMIN(gc->count, (u64)GAIN_CACHE_MAX);
+    for (u64 i = 0; i < n; i++)
+    {
+        const gain_entry *e = &gc->entries[i];
+        if (e->model_hash != w->model_hash) continue;
+        f64 d = gain_distance(e, q, R);
+        if (d == 0.0)
+        {
+            *exact = true;
+            return e;
+        }
+        if (d <= best_distance)
+        {
+            best = e;
+            best_distance = d;
+        }
+    }
+    *exact = false;
+    return best;
+}
+
+void
+gain_insert(world *w, const gain_entry *e)
+{
+    gain_cache *gc = w->gains;
+    if (!gc) return;
+    u64 n = mjMIN(gc->count, (u64)GAIN_CACHE_MAX);
+    for (u64 i = 0; i < n; i++)
+        if (gain_same_key(&gc->entries[i], e)) return;
+    gc->entries[gc->count % GAIN_CACHE_MAX] = *e;
+    gc->count++;
+    if (gc->fd < 0) return;
+    // one locked write per record on an O_APPEND descriptor, so concurrent launches append whole entries
+    flock(gc->fd, LOCK_EX);
+    if (write(gc->fd, e, sizeof(*e)) != sizeof(*e)) fprintf(stderr, "gain cache: write failed\n");
+    flock(gc->fd, LOCK_UN);
+}
@@ -0,0 +1,30 @@
+#include "base.hpp"
+#include <stdlib.h>
+
+#define HASH_SEED 1469598103934665603ull
+
+u64 hash_bytes(const void *data, size_t size, u64 seed);
+u64 model_hash(const mjModel *m);
+
+// FNV-1a, chainable through seed
+u64
+hash_bytes(const void *data, size_t size, u64 seed)
+{
+    const u8 *p = (const u8 *)data;
+    u64 h = seed;
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// hash of the compiled model as serialized by mj_saveModel, so it changes with any edit that changes the model
+u64
+model_hash(const mjModel *m)
+{
+    i32 size = mj_sizeModel(m);
+    void *buffer = malloc(size);
+    mj_saveModel(m, NULL, buffer, size);
+    u64 h = hash_bytes(buffer, size, HASH_SEED);
+    free(buffer);
+    return h;
+}
@@ -0,0 +1,151 @@
+#include "base.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Root locus of the closed-loop poles of A - BK as one diagonal weight of Q is swept over a log grid, with the other
+// weights, A, B and R held at their current values. A background thread solves the CARE point by point and publishes
+// each one as it finishes, so the panel can draw a partial trace. Traces are cached by everything except the swept
+// weight: dragging the swept slider only moves the highlighted point, and returning to an earlier setting of the other
+// sliders reuses its trace (a half-finished one resumes where it stopped).
+
+#define LOCUS_POINTS 96
+#define LOCUS_CACHE 8
+#define LOCUS_MIN_WEIGHT 1e-2
+#define LOCUS_MAX_WEIGHT 1e4
+
+typedef struct locus_trace {
+    u64 key; // 0: empty slot
+    u64 last_used;
+    Eigen::Matrix<f64, nstate, nstate> A;
+    Eigen::Matrix<f64, nstate, nact> B;
+    Eigen::Matrix<f64, nstate, nstate> Q;
+    f64 R;
+    i32 weight; // index of the swept diagonal entry of Q
+    std::complex<f64> poles[LOCUS_POINTS][nstate];
+    bool solved[LOCUS_POINTS];
+    std::atomic<i32> done; // points [0, done) are published
+} locus_trace;
+
+typedef struct locus_state {
+    locus_trace traces[LOCUS_CACHE];
+    locus_trace *wanted; // trace the panel is showing, the worker fills it
+    locus_trace *busy;   // trace the worker is writing right now, outside the lock
+    u64 uses;
+    bool quit;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread worker;
+} locus_state;
+
+void init_locus(world *w);
+void destroy_locus(world *w);
+const locus_trace *locus_request(world *w, i32 weight);
+f64 locus_weight(i32 i);
+
+f64
+locus_weight(i32 i)
+{
+    return LOCUS_MIN_WEIGHT * pow(LOCUS_MAX_WEIGHT / LOCUS_MIN_WEIGHT, (f64)i / (LOCUS_POINTS - 1));
+}
+
+void
+locus_worker(locus_state *ls)
+{
+    std::unique_lock<std::mutex> guard(ls->lock);
+    while (!ls->quit)
+    {
+        locus_trace *t = ls->wanted;
+        if (!t || t->done.load(std::memory_order_relaxed) == LOCUS_POINTS)
+        {
+            ls->wake.wait(guard);
+            continue;
+        }
+
+        // solve one point outside the lock; the inputs of a trace never change while it is cached
+        i32 i = t->done.load(std::memory_order_relaxed);
+        ls->busy = t;
+        guard.unlock();
+        Eigen::Matrix<f64, nstate, nstate> Q = t->Q;
+        Q(t->weight, t->weight) = locus_weight(i);
+        Eigen::Matrix<f64, nstate, nstate> P;
+        t->solved[i] = solve_continuous_are(t->A, t->B, Q, t->R, P);
+        if (t->solved[i])
+        {
+            Eigen::Matrix<f64, nact, nstate> K = (1 / t->R) * t->B.transpose() * P;
+            Eigen::Matrix<f64, nstate, nstate> Acl = t->A - t->B * K;
+            Eigen::EigenSolver<Eigen::Matrix<f64, nstate, nstate> > es(Acl, false);
+            for (i32 k = 0; k < nstate; k++)
+                t->poles[i][k] = es.eigenvalues()(k);
+        }
+        t->done.store(i + 1, std::memory_order_release);
+        guard.lock();
+        ls->busy = NULL;
+    }
+}
+
+void
+init_locus(world *w)
+{
+    locus_state *ls = new locus_state();
+    ls->worker = std::thread(locus_worker, ls);
+    w->locus = ls;
+}
+
+void
+destroy_locus(world *w)
+{
+    locus_state *ls = w->locus;
+    if (!ls) return;
+    {
+        std::lock_guard<std::mutex> guard(ls->lock);
+        ls->quit = true;
+    }
+    ls->wake.notify_one();
+    ls->worker.join();
+    delete ls;
+    w->locus = NULL;
+}
+
+// trace for the current A, B, R and Q with entry `weight` swept; starts or resumes it in the background when needed
+const locus_trace *
+locus_request(world *w, i32 weight)
+{
+    locus_state *ls = w->locus;
+    Eigen::Matrix<f64, nstate, nstate> Q = w->Q;
+    Q(weight, weight) = 0;
+    u64 key = hash_bytes(w->A.data(), sizeof(f64) * w->A.size(), HASH_SEED);
+    key = hash_bytes(w->B.data(), sizeof(f64) * w->B.size(), key);
+    key = hash_bytes(Q.data(), sizeof(f64) * Q.size(), key);
+    key = hash_bytes(&w->R, sizeof(w->R), key);
+    key = hash_bytes(&weight, sizeof(weight), key) | 1;
+
+    std::lock_guard<std::mutex> guard(ls->lock);
+    locus_trace *hit = NULL;
+    locus_trace *victim = NULL;
+    for (locus_trace &t : ls->traces)
+    {
+        if (t.key == key) hit = &t;
+        // never recycle a trace the worker may be writing
+        if (&t != ls->wanted && &t != ls->busy && (!victim || t.last_used < victim->last_used)) victim = &t;
+    }
+    if (!hit)
+    {
+        hit = victim;
+        hit->key = key;
+        hit->A = w->A;
+        hit->B = w->B;
+        hit->Q = Q;
+        hit->R = w->R;
+        hit->weight = weight;
+        hit->done.store(0, std::memory_order_relaxed);
+    }
+    hit->last_used = ++ls->uses;
+    if (ls->wanted != hit)
+    {
+        ls->wanted = hit;
+        ls->wake.notify_one();
+    }
+    return hit;
+}
@@ -1,29 +1,222 @@
+#include "alloc.cpp"
+#include "clock.cpp"
+#include "hash.cpp"
+#include "rng.cpp"
+#include "gains.cpp"
 #include "math.cpp"
+#include "rt.cpp"
+#include "model.cpp"
+#include "locus.cpp"
+#include "freq.cpp"
+#include "codec.cpp"
+#include "telemetry.cpp"
+#include "stream.cpp"
+#include "metrics.cpp"
+#include "rewind.cpp"
+#include "plot.cpp"
+#include "batch.cpp"
+#include "fleet.cpp"
+#include "extctl.cpp"
+#include "sim.cpp"
+#include "replay.cpp"
+#include "params.cpp"
+#include "reload.cpp"
+#include "analyze.cpp"
+#include "vecenv.cpp"
+#include "determinism.cpp"
 #include "ui.cpp"
-#include <unistd.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+void
+parse_args(world *w, i32 argc, char **argv)
+{
+    for (i32 i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--rt"))
+        {
+            w->rt_enabled = true;
+        }
+        else if (!strcmp(argv[i], "--rt-cpu") && i + 1 < argc)
+        {
+            w->rt_cpu = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--rt-priority") && i + 1 < argc)
+        {
+            w->rt_priority = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+        {
+            snprintf(w->telemetry_path, sizeof(w->telemetry_path), "%s", argv[++i]);
+            w->telemetry_autostart = true;
+        }
+        else if (!strcmp(argv[i], "--record-resolution") && i + 1 < argc)
+        {
+            w->telemetry_quantum = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--stream") && i + 1 < argc)
+        {
+            snprintf(w->stream_path, sizeof(w->stream_path), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            w->seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--metrics") && i + 1 < argc)
+        {
+            snprintf(w->metrics_path, sizeof(w->metrics_path), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--metrics-socket") && i + 1 < argc)
+        {
+            snprintf(w->metrics_socket, sizeof(w->metrics_socket), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--alloc-guard") && i + 1 < argc)
+        {
+            i++;
+            if (!strcmp(argv[i], "count"))
+                w->alloc_mode = ALLOC_COUNT;
+            else if (!strcmp(argv[i], "forbid"))
+                w->alloc_mode = ALLOC_FORBID;
+            else
+                w->alloc_mode = ALLOC_OFF;
+        }
+        else if (!strcmp(argv[i], "--scene") && i + 1 < argc)
+        {
+            snprintf(w->scene_path, sizeof(w->scene_path), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--cache-dir") && i + 1 < argc)
+        {
+            snprintf(w->cache_dir, sizeof(w->cache_dir), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--no-model-cache"))
+        {
+            w->model_cache = false;
+        }
+        else if (!strcmp(argv[i], "--no-gain-cache"))
+        {
+            w->use_gain_cache = false;
+        }
+        else if (!strcmp(argv[i], "--fleet") && i + 1 < argc)
+        {
+            w->fleet_size = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--ext-control") && i + 1 < argc)
+        {
+            snprintf(w->ext_name, sizeof(w->ext_name), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--ext-deadline-us") && i + 1 < argc)
+        {
+            w->ext_deadline_us = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--ext-client") && i + 1 < argc)
+        {
+            snprintf(w->ext_client_name, sizeof(w->ext_client_name), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--bench-control"))
+        {
+            w->bench_control_n = i + 1 < argc && isdigit((u8)argv[i + 1][0]) ? atoi(argv[++i]) : 4096;
+        }
+        else if (!strcmp(argv[i], "--verify-determinism"))
+        {
+            w->verify_determinism_n = i + 1 < argc && isdigit((u8)argv[i + 1][0]) ? atoi(argv[++i]) : 64;
+        }
+        else if (!strcmp(argv[i], "--analyze") && i + 1 < argc)
+        {
+            snprintf(w->analyze_path, sizeof(w->analyze_path), "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            w->analyze_threads = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr,
+                    "usage: %s [--rt] [--rt-cpu N] [--rt-priority N] [--record PATH] [--record-resolution Q]\n"
+                    "       %*s [--alloc-guard count|forbid] [--scene PATH] [--cache-dir DIR] [--no-model-cache] [--no-gain-cache]\n"
+                    "       %*s [--fleet N] [--ext-control NAME] [--ext-deadline-us N] [--stream PATH]\n"
+                    "       %*s [--metrics PATH] [--metrics-socket PATH] [--seed N]\n"
+                    "       %s --analyze DIR [--threads N]\n"
+                    "       %s --bench-control [N]\n"
+                    "       %s --ext-client NAME\n"
+                    "       %s --verify-determinism [N] [--scene PATH]\n",
+                    argv[0], (i32)strlen(argv[0]), "", (i32)strlen(argv[0]), "", (i32)strlen(argv[0]), "", argv[0], argv[0], argv[0], argv[0]);
+            exit(1);
+        }
+    }
+}
 
 i32
-main()
+main(i32 argc, char **argv)
 {
     world w = { 0 };
+    parse_args(&w, argc, argv);
+    if (w.analyze_path[0]) return analyze_logs(w.analyze_path, w.analyze_threads);
+    if (w.bench_control_n) return bench_control(w.bench_control_n);
+    if (w.ext_client_name[0]) return ext_client(w.ext_client_name);
+    if (w.verify_determinism_n) return verify_determinism(w.verify_determinism_n, w.scene_path[0] ? w.scene_path : NULL);
+    startup_begin(&w);
+    alloc_guard_init(&w);
+    load_model(&w);
+    startup_mark(&w, "model");
     init_ui(&w);
+    startup_mark(&w, "window");
+    init_gains(&w);
     init_math(&w);
+    set_control_callback(&w, w.control_in_mujoco);
+    startup_mark(&w, "lqr");
+    init_locus(&w);
+    init_freq(&w);
+    init_rt(&w);
+    init_rewind(&w);
+    init_plots(&w);
+    init_fleet(&w);
+    init_ext(&w);
+    init_stream(&w);
+    init_metrics(&w);
+    init_params(&w);
+    init_reload(&w);
+    if (w.telemetry_autostart) telemetry_start(&w, w.telemetry_path);
+    startup_mark(&w, "subsystems");
+    startup_report(&w);
 
     while (!glfwWindowShouldClose(w.window))
     {
+        reload_poll(&w);
+        params_poll(&w);
         if (w.q_updated)
         {
+            alloc_guard_begin("compute_lqr_gain");
             compute_lqr_gain(&w);
+            alloc_guard_end();
             w.q_updated = false;
         }
-        control(&w);
+        if (w.replay)
+            replay_advance(&w);
+        else
+            step_sim(&w);
         draw_sim(&w);
         draw_panel(&w);
         glfwSwapBuffers(w.window);
         glfwPollEvents();
-        usleep(10000);
+        metrics_poll(&w);
+        pace_frame(&w);
     }
 
+    destroy_reload(&w);
+    destroy_params(&w);
+    telemetry_stop(&w);
+    replay_close(&w);
+    destroy_rewind(&w);
+    destroy_plots(&w);
+    destroy_fleet(&w);
+    destroy_ext(&w);
+    destroy_stream(&w);
+    destroy_metrics(&w);
+    destroy_locus(&w);
+    destroy_freq(&w);
+    destroy_gains(&w);
+    rt_report(&w);
+    alloc_guard_report();
     destroy_ui(&w);
     return 0;
 }
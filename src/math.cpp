@@ -1,21 +1,38 @@
 #include "base.hpp"
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <mujoco/mujoco.h>
 
+// mjcb_control is a process global read by every mj_forward, including the reload and parameter worker threads. It is
+// installed once before those threads exist and then only gated through these atomics; the callback touches the world
+// only for the live mjData, which the main thread alone steps.
+static const world *control_world; // mjcb_control carries no user pointer; set once with the callback
+static std::atomic<bool> control_enabled;
+static std::atomic<const mjData *> control_data;
+
+void
+read_state_from_data(const world *w,              //
+                     const mjData *d,             //
+                     Eigen::Matrix<f64, 4, 1> &x, //
+                     Eigen::Matrix<f64, 4, 1> &y)
+{
+    x(0) = d->qpos[w->platform_x_qpos_id];
+    x(1) = d->qpos[w->hinge_y_qpos_id];
+    x(2) = d->qvel[w->platform_x_qvel_id];
+    x(3) = d->qvel[w->hinge_y_qvel_id];
+    y(0) = d->qpos[w->platform_y_qpos_id];
+    y(1) = -d->qpos[w->hinge_x_qpos_id];
+    y(2) = d->qvel[w->platform_y_qvel_id];
+    y(3) = -d->qvel[w->hinge_x_qvel_id];
+}
+
 void
 read_state_from_sim(world *w,                    //
                     Eigen::Matrix<f64, 4, 1> &x, //
                     Eigen::Matrix<f64, 4, 1> &y)
 {
-    x(0) = w->data->qpos[w->platform_x_qpos_id];
-    x(1) = w->data->qpos[w->hinge_y_qpos_id];
-    x(2) = w->data->qvel[w->platform_x_qvel_id];
-    x(3) = w->data->qvel[w->hinge_y_qvel_id];
-    y(0) = w->data->qpos[w->platform_y_qpos_id];
-    y(1) = -w->data->qpos[w->hinge_x_qpos_id];
-    y(2) = w->data->qvel[w->platform_y_qvel_id];
-    y(3) = -w->data->qvel[w->hinge_x_qvel_id];
+    read_state_from_data(w, w->data, x, y);
 }
 
 void
@@ -60,16 +77,14 @@ linearize_system(world *w,                       //
     y0.setZero();
     u0.setZero();
 
-    // store original sim qpos/qvel and ctrl to restore later
-    Eigen::VectorXd qpos_orig(w->model->nq);
-    Eigen::VectorXd qvel_orig(w->model->nv);
-    for (i32 i = 0; i < w->model->nq; ++i)
-        qpos_orig(i) = w->data->qpos[i];
-    for (i32 i = 0; i < w->model->nv; ++i)
-        qvel_orig(i) = w->data->qvel[i];
-    Eigen::VectorXd ctrl_orig(1);
-    for (i32 i = 0; i < 1; ++i)
-        ctrl_orig(i) = w->data->ctrl[i];
+    // store original sim qpos/qvel and ctrl to restore later, on the mjData arena so nothing hits the heap
+    mj_markStack(w->data);
+    mjtNum *qpos_orig = mj_stackAllocNum(w->data, w->model->nq);
+    mjtNum *qvel_orig = mj_stackAllocNum(w->data, w->model->nv);
+    mjtNum *ctrl_orig = mj_stackAllocNum(w->data, w->model->nu);
+    mju_copy(qpos_orig, w->data->qpos, w->model->nq);
+    mju_copy(qvel_orig, w->data->qvel, w->model->nv);
+    mju_copy(ctrl_orig, w->data->ctrl, w->model->nu);
 
     // set base state & compute baseline xdot
     write_state_to_sim(w, x0, y0);
@@ -93,7 +108,7 @@ linearize_system(world *w,                       //
     // jacobian wrt u
     for (i32 j = 0; j < 1; ++j)
     {
-        Eigen::VectorXd u_pert = u0;
+        Eigen::Matrix<f64, 1, 1> u_pert = u0;
         u_pert(j) += eps;
 
         write_state_to_sim(w, x0, y0);
@@ -102,12 +117,10 @@ linearize_system(world *w,                       //
     }
 
     // restore sim qpos/qvel/ctrl
-    for (i32 i = 0; i < w->model->nq; i++)
-        w->data->qpos[i] = qpos_orig(i);
-    for (i32 i = 0; i < w->model->nv; i++)
-        w->data->qvel[i] = qvel_orig(i);
-    for (i32 i = 0; i < 1; i++)
-        w->data->ctrl[i] = ctrl_orig(i);
+    mju_copy(w->data->qpos, qpos_orig, w->model->nq);
+    mju_copy(w->data->qvel, qvel_orig, w->model->nv);
+    mju_copy(w->data->ctrl, ctrl_orig, w->model->nu);
+    mj_freeStack(w->data);
     mj_forward(w->model, w->data); // refresh
 
     Aout = A;
@@ -141,7 +154,7 @@ solve_continuous_are(const Eigen::Matrix<f64, 4, 4> &A, //
 
     // Collect 4 eigenvectors whose eigenvalue has negative real part
     const f64 neg_thresh = -1e-12; // small negative threshold
-    Eigen::MatrixXcd U(2 * 4, 4);  // complex container
+    Eigen::Matrix<std::complex<f64>, 2 * 4, 4> U; // fixed size, no heap
     i32 col = 0;
     for (i32 i = 0; i < 2 * 4 && col < 4; ++i)
     {
@@ -167,14 +180,14 @@ solve_continuous_are(const Eigen::Matrix<f64, 4, 4> &A, //
     }
 
     // Partition U into U1 (top n rows) and U2 (bottom n rows)
-    Eigen::MatrixXcd U1 = U.block(0, 0, 4, 4);
-    Eigen::MatrixXcd U2 = U.block(4, 0, 4, 4);
+    Eigen::Matrix<std::complex<f64>, 4, 4> U1 = U.block<4, 4>(0, 0);
+    Eigen::Matrix<std::complex<f64>, 4, 4> U2 = U.block<4, 4>(4, 0);
 
     // Invert U1 (complex)
-    Eigen::FullPivLU<Eigen::MatrixXcd> lu(U1);
+    Eigen::FullPivLU<Eigen::Matrix<std::complex<f64>, 4, 4> > lu(U1);
     if (!lu.isInvertible()) return false;
 
-    Eigen::MatrixXcd P_c = U2 * U1.inverse();
+    Eigen::Matrix<std::complex<f64>, 4, 4> P_c = U2 * lu.inverse();
 
     // P_out should be real symmetric; take real part and symmetrize
     Eigen::Matrix<f64, 4, 4> P_real;
@@ -186,23 +199,89 @@ solve_continuous_are(const Eigen::Matrix<f64, 4, 4> &A, //
     return true;
 }
 
-// ---------------------------
-// High-level: compute LQR K for continuous A,B,Q,R
-// returns K (m x n) such that u = -K x
-// ---------------------------
+// closed-loop poles for the current K; also needed when K is changed by hand
+void
+update_poles(world *w)
+{
+    Eigen::EigenSolver<Eigen::Matrix<f64, nstate, nstate> > es(w->A - w->B * w->K, false);
+    w->poles = es.eigenvalues();
+}
+
+// A, B and K of a synthesis, e.g. from the gain cache
+void
+apply_gain_entry(world *w, const gain_entry *e, i32 source)
+{
+    w->A = Eigen::Map<const Eigen::Matrix<f64, nstate, nstate> >(e->A);
+    w->B = Eigen::Map<const Eigen::Matrix<f64, nstate, nact> >(e->B);
+    w->K = Eigen::Map<const Eigen::Matrix<f64, nact, nstate> >(e->K);
+    w->gain_source = source;
+    update_poles(w);
+}
+
+// take the gain for the current model, Q and R from the synthesis cache if it has one
 bool
-compute_lqr_gain(world *w)
+lqr_from_cache(world *w)
+{
+    f64 q[nstate];
+    for (i32 i = 0; i < nstate; i++)
+        q[i] = w->Q(i, i);
+    bool exact;
+    const gain_entry *cached = gain_lookup(w, q, w->R, &exact);
+    if (!cached) return false;
+    apply_gain_entry(w, cached, exact ? GAIN_EXACT : GAIN_NEAREST);
+    return true;
+}
+
+// linearize the model of w and solve the CARE for Q and R, filling the whole synthesis into e; A and B are filled
+// even when the CARE fails. Does not touch w's gains, so it also serves background worlds.
+bool
+synthesize_lqr(world *w, const Eigen::Matrix<f64, 4, 4> &Q, f64 R, gain_entry *e)
 {
     Eigen::Matrix<f64, 4, 4> A;
     Eigen::Matrix<f64, 4, 1> B;
     f64 eps = 1e-6;
+    // the finite differences set ctrl themselves, keep the closed-loop callback out of them. It already ignores every
+    // mjData but the live one, so only the live world has to switch it off.
+    bool mask = w == control_world && control_enabled.exchange(false);
     linearize_system(w, eps, A, B);
+    if (mask) control_enabled.store(true);
+
+    e->model_hash = w->model_hash;
+    for (i32 i = 0; i < nstate; i++)
+        e->q[i] = Q(i, i);
+    e->R = R;
+    Eigen::Map<Eigen::Matrix<f64, nstate, nstate> >(e->A) = A;
+    Eigen::Map<Eigen::Matrix<f64, nstate, nact> >(e->B) = B;
 
-    f64 R = 1;
     Eigen::Matrix<f64, 4, 4> P;
-    if (!solve_continuous_are(A, B, w->Q, R, P)) return false;
+    if (!solve_continuous_are(A, B, Q, R, P)) return false;
+    Eigen::Map<Eigen::Matrix<f64, nstate, nstate> >(e->P) = P;
     // K = R^-1 * B^T * P
-    w->K = (1 / R) * B.transpose() * P;
+    Eigen::Map<Eigen::Matrix<f64, nact, nstate> >(e->K) = (1 / R) * B.transpose() * P;
+    return true;
+}
+
+// ---------------------------
+// High-level: compute LQR K for continuous A,B,Q,R
+// returns K (m x n) such that u = -K x
+// ---------------------------
+bool
+compute_lqr_gain(world *w)
+{
+    if (lqr_from_cache(w)) return true;
+
+    gain_entry e;
+    bool solved = synthesize_lqr(w, w->Q, w->R, &e);
+    w->A = Eigen::Map<const Eigen::Matrix<f64, nstate, nstate> >(e.A);
+    w->B = Eigen::Map<const Eigen::Matrix<f64, nstate, nact> >(e.B);
+    w->gain_recomputes++;
+    if (!solved)
+    {
+        w->care_failures++;
+        return false;
+    }
+    apply_gain_entry(w, &e, GAIN_SOLVED);
+    gain_insert(w, &e);
     return true;
 }
 
@@ -216,8 +295,38 @@ control(world *w)
     w->data->ctrl[1] = w->uy;
 }
 
+// LQR law as a MuJoCo control callback, so every mj_forward of the live pendulum (substeps, mjd_transitionFD on its
+// mjData) sees the closed loop. It is evaluated on every call rather than held at control_hz: a stateless policy is
+// what finite differencing expects. Other mjData of the same model, e.g. the fleet with its own batched law, are left
+// alone.
 void
-init_math(world *w)
+control_callback(const mjModel *m, mjData *d)
+{
+    if (!control_enabled.load(std::memory_order_relaxed) || d != control_data.load(std::memory_order_relaxed)) return;
+    const world *w = control_world; // on the main thread: d is the live mjData
+    Eigen::Matrix<f64, 4, 1> x;
+    Eigen::Matrix<f64, 4, 1> y;
+    read_state_from_data(w, d, x, y);
+    d->ctrl[0] = -(w->K * x)(0);
+    d->ctrl[1] = -(w->K * y)(0);
+}
+
+// installs the callback on the first call, which has to come before any worker thread starts; later calls only switch
+// it and follow w->data across reloads
+void
+set_control_callback(world *w, bool enabled)
+{
+    if (!control_world)
+    {
+        control_world = w;
+        mjcb_control = control_callback;
+    }
+    control_data.store(w->data);
+    control_enabled.store(enabled);
+}
+
+void
+resolve_joint_ids(world *w)
 {
     i32 j_platform_x = mj_name2id(w->model, mjOBJ_JOINT, "platform_x");
     i32 j_platform_y = mj_name2id(w->model, mjOBJ_JOINT, "platform_y");
@@ -233,7 +342,12 @@ init_math(world *w)
     w->platform_y_qvel_id = w->model->jnt_dofadr[j_platform_y];
     w->hinge_x_qvel_id = w->model->jnt_dofadr[j_hinge_x];
     w->hinge_y_qvel_id = w->model->jnt_dofadr[j_hinge_y];
+}
 
+void
+init_math(world *w)
+{
+    resolve_joint_ids(w);
     w->Q.setZero();
     w->Q(0, 0) = w->q_pos_penalty;
     w->Q(1, 1) = w->q_angle_penalty;
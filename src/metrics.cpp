@@ -0,0 +1,285 @@
+#include "base.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <errno.h>
+#include <mutex>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// Loop health in the OpenMetrics text format (--metrics PATH, --metrics-socket PATH). The sim thread times every
+// physics step into a fixed window and counts MuJoCo warnings and saturated controls; every METRICS_PERIOD_MS the main
+// loop formats a snapshot, which an exporter thread writes to PATH through a temporary file and rename (so a scraper
+// never reads half a file) and serves to every connection on the Unix socket, as an HTTP response when the client
+// sends a GET (curl --unix-socket) and as the bare text otherwise.
+
+#define METRICS_PERIOD_MS 2000
+#define METRICS_STEP_SAMPLES 4096
+#define METRICS_TEXT_SIZE 8192
+
+typedef struct metrics_state {
+    // sim thread
+    i64 step_ns[METRICS_STEP_SAMPLES];
+    i64 sorted_ns[METRICS_STEP_SAMPLES];
+    u64 step_count;
+    i64 step_sum_ns;
+    u64 saturations;
+    i32 warning_last[mjNWARNING];
+    u64 warnings[mjNWARNING];
+    i64 next_snapshot_ns;
+
+    // latest snapshot, handed to the exporter thread
+    std::mutex lock;
+    std::condition_variable wake;
+    char text[METRICS_TEXT_SIZE];
+    i32 len;
+    u64 generation;
+    bool quit;
+
+    char path[256];
+    char socket_path[108];
+    i32 listen_fd;
+    std::thread worker;
+    char served[METRICS_TEXT_SIZE]; // exporter thread's copy
+    std::atomic<u64> scrapes;
+} metrics_state;
+
+void init_metrics(world *w);
+void destroy_metrics(world *w);
+void metrics_step(world *w, i64 step_ns);
+void metrics_poll(world *w);
+
+const char *metrics_warning_names[mjNWARNING] = { "inertia", "contactfull", "cnstrfull", "vgeomfull",
+                                                  "badqpos", "badqvel",     "badqacc",   "badctrl" };
+
+// sim thread, after every physics step with the step's wall time
+void
+metrics_step(world *w, i64 step_ns)
+{
+    metrics_state *ms = w->metrics;
+    if (!ms) return;
+    ms->step_ns[ms->step_count++ % METRICS_STEP_SAMPLES] = step_ns;
+    ms->step_sum_ns += step_ns;
+
+    const mjModel *m = w->model;
+    const mjData *d = w->data;
+    for (i32 i = 0; i < m->nu; i++)
+    {
+        if (!m->actuator_ctrllimited[i]) continue;
+        if (d->ctrl[i] < m->actuator_ctrlrange[2 * i] || d->ctrl[i] > m->actuator_ctrlrange[2 * i + 1])
+        {
+            ms->saturations++;
+            break;
+        }
+    }
+    // MuJoCo's counts restart on mj_resetData and with a new mjData after a reload
+    for (i32 i = 0; i < mjNWARNING; i++)
+    {
+        i32 n = d->warning[i].number;
+        ms->warnings[i] += n >= ms->warning_last[i] ? n - ms->warning_last[i] : n;
+        ms->warning_last[i] = n;
+    }
+}
+
+// step-time quantile over the last METRICS_STEP_SAMPLES steps, in seconds
+f64
+metrics_step_quantile(metrics_state *ms, f64 p)
+{
+    i32 n = (i32)mjMIN(ms->step_count, (u64)METRICS_STEP_SAMPLES);
+    if (!n) return 0.0;
+    memcpy(ms->sorted_ns, ms->step_ns, n * sizeof(i64));
+    i32 k = mjMIN(n - 1, (i32)(p * n));
+    std::nth_element(ms->sorted_ns, ms->sorted_ns + k, ms->sorted_ns + n);
+    return ms->sorted_ns[k] / 1e9;
+}
+
+#define METRICS_APPEND(...) len += snprintf(out + len, len < size ? size - len : 0, __VA_ARGS__)
+
+i32
+metrics_format(world *w, char *out, i32 size)
+{
+    metrics_state *ms = w->metrics;
+    i32 len = 0;
+    METRICS_APPEND("# TYPE muludnep_physics_steps counter\n# HELP muludnep_physics_steps Physics steps taken.\n");
+    METRICS_APPEND("muludnep_physics_steps_total %llu\n", (unsigned long long)w->physics_steps);
+    METRICS_APPEND("# TYPE muludnep_real_time_factor gauge\n# HELP muludnep_real_time_factor Sim time over wall time in the last second.\n");
+    METRICS_APPEND("muludnep_real_time_factor %.6g\n", w->measured_rtf);
+    METRICS_APPEND("# TYPE muludnep_step_seconds summary\n# UNIT muludnep_step_seconds seconds\n");
+    METRICS_APPEND("# HELP muludnep_step_seconds Wall time of a physics step including control, over the last %d steps.\n",
+                   METRICS_STEP_SAMPLES);
+    METRICS_APPEND("muludnep_step_seconds{quantile=\"0.5\"} %.9g\n", metrics_step_quantile(ms, 0.5));
+    METRICS_APPEND("muludnep_step_seconds{quantile=\"0.99\"} %.9g\n", metrics_step_quantile(ms, 0.99));
+    METRICS_APPEND("muludnep_step_seconds_count %llu\n", (unsigned long long)ms->step_count);
+    METRICS_APPEND("muludnep_step_seconds_sum %.9g\n", ms->step_sum_ns / 1e9);
+    METRICS_APPEND("# TYPE muludnep_gain_recomputes counter\n# HELP muludnep_gain_recomputes LQR syntheses (linearization and CARE).\n");
+    METRICS_APPEND("muludnep_gain_recomputes_total %llu\n", (unsigned long long)w->gain_recomputes);
+    METRICS_APPEND("# TYPE muludnep_care_failures counter\n# HELP muludnep_care_failures Syntheses whose CARE had no solution.\n");
+    METRICS_APPEND("muludnep_care_failures_total %llu\n", (unsigned long long)w->care_failures);
+    METRICS_APPEND("# TYPE muludnep_mujoco_warnings counter\n# HELP muludnep_mujoco_warnings MuJoCo warnings by kind.\n");
+    for (i32 i = 0; i < mjNWARNING; i++)
+        METRICS_APPEND("muludnep_mujoco_warnings_total{warning=\"%s\"} %llu\n", metrics_warning_names[i], (unsigned long long)ms->warnings[i]);
+    METRICS_APPEND("# TYPE muludnep_control_saturations counter\n");
+    METRICS_APPEND("# HELP muludnep_control_saturations Physics steps with a control outside its actuator's ctrlrange.\n");
+    METRICS_APPEND("muludnep_control_saturations_total %llu\n", (unsigned long long)ms->saturations);
+    METRICS_APPEND("# EOF\n");
+    return mjMIN(len, size - 1);
+}
+
+#undef METRICS_APPEND
+
+// main loop, every frame; formats a snapshot every METRICS_PERIOD_MS
+void
+metrics_poll(world *w)
+{
+    metrics_state *ms = w->metrics;
+    if (!ms) return;
+    i64 now = now_ns();
+    if (now < ms->next_snapshot_ns) return;
+    ms->next_snapshot_ns = now + (i64)METRICS_PERIOD_MS * 1000000;
+    char text[METRICS_TEXT_SIZE];
+    i32 len = metrics_format(w, text, sizeof(text));
+    {
+        std::lock_guard<std::mutex> guard(ms->lock);
+        memcpy(ms->text, text, len);
+        ms->len = len;
+        ms->generation++;
+    }
+    ms->wake.notify_one();
+}
+
+void
+metrics_write_file(const char *path, const char *text, i32 len)
+{
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "metrics: cannot write %s (%s)\n", tmp, strerror(errno));
+        return;
+    }
+    bool ok = fwrite(text, 1, len, f) == (size_t)len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) fprintf(stderr, "metrics: cannot update %s (%s)\n", path, strerror(errno));
+}
+
+void
+metrics_write_all(i32 fd, const char *p, i32 len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, 0);
+        if (n <= 0) return;
+        p += n;
+        len -= (i32)n;
+    }
+}
+
+// one scrape: give the client a moment to send its request, answer in kind, close
+void
+metrics_serve(metrics_state *ms, i32 fd, const char *text, i32 len)
+{
+    char request[512];
+    pollfd p = { fd, POLLIN, 0 };
+    ssize_t n = poll(&p, 1, 50) > 0 ? recv(fd, request, sizeof(request), 0) : 0;
+    if (n >= 4 && !memcmp(request, "GET ", 4))
+    {
+        char header[200];
+        i32 hlen = snprintf(header, sizeof(header),
+                            "HTTP/1.0 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                            "Content-Length: %d\r\n\r\n",
+                            len);
+        metrics_write_all(fd, header, hlen);
+    }
+    metrics_write_all(fd, text, len);
+    close(fd);
+    ms->scrapes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+metrics_export(metrics_state *ms)
+{
+    char *text = ms->served;
+    u64 written = 0;
+    for (;;)
+    {
+        i32 len;
+        u64 generation;
+        {
+            std::unique_lock<std::mutex> guard(ms->lock);
+            // without a socket there is nothing to do between snapshots
+            if (ms->listen_fd < 0) ms->wake.wait(guard, [&] { return ms->quit || ms->generation != written; });
+            if (ms->quit) return;
+            memcpy(text, ms->text, ms->len);
+            len = ms->len;
+            generation = ms->generation;
+        }
+        if (ms->path[0] && generation != written && len) metrics_write_file(ms->path, text, len);
+        written = generation;
+        if (ms->listen_fd < 0) continue;
+
+        pollfd p = { ms->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, 100) <= 0) continue;
+        i32 fd = accept(ms->listen_fd, NULL, NULL);
+        if (fd >= 0) metrics_serve(ms, fd, text, len);
+    }
+}
+
+void
+init_metrics(world *w)
+{
+    if (!w->metrics_path[0] && !w->metrics_socket[0]) return;
+    metrics_state *ms = new metrics_state();
+    snprintf(ms->path, sizeof(ms->path), "%s", w->metrics_path);
+    snprintf(ms->socket_path, sizeof(ms->socket_path), "%s", w->metrics_socket);
+    ms->listen_fd = -1;
+    if (ms->socket_path[0])
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", ms->socket_path);
+        i32 fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(ms->socket_path); // left over from a crashed run
+        if (fd >= 0 && bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 8) == 0)
+        {
+            ms->listen_fd = fd;
+        }
+        else
+        {
+            fprintf(stderr, "metrics: cannot listen on %s (%s)\n", ms->socket_path, strerror(errno));
+            if (fd >= 0) close(fd);
+            ms->socket_path[0] = 0;
+        }
+    }
+    w->metrics = ms;
+    metrics_poll(w); // something to serve before the first period is up
+    ms->worker = std::thread(metrics_export, ms);
+}
+
+void
+destroy_metrics(world *w)
+{
+    metrics_state *ms = w->metrics;
+    if (!ms) return;
+    ms->next_snapshot_ns = 0;
+    metrics_poll(w); // final counts
+    {
+        std::lock_guard<std::mutex> guard(ms->lock);
+        ms->quit = true;
+    }
+    ms->wake.notify_one();
+    ms->worker.join();
+    if (ms->path[0]) metrics_write_file(ms->path, ms->text, ms->len);
+    if (ms->listen_fd >= 0)
+    {
+        close(ms->listen_fd);
+        unlink(ms->socket_path);
+    }
+    delete ms;
+    w->metrics = NULL;
+}
@@ -0,0 +1,131 @@
+#include "base.hpp"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Compiled-model cache. Parsing and compiling scene[] dominates startup, so the compiled model is saved as MJB under
+// cache_dir, named by a hash of the XML, the MuJoCo version and the mjtNum size, and loaded with mj_loadModel on later
+// launches. A missing, stale or unreadable file just falls back to compiling; files are written to a temporary name
+// and renamed, so concurrent launches never see a partial one.
+
+mjModel *compile_scene(const world *w, const char *xml, bool *from_cache, char *error, i32 error_size);
+char *read_text_file(const char *path);
+void load_model(world *w);
+void startup_begin(world *w);
+void startup_mark(world *w, const char *stage);
+void startup_report(world *w);
+
+// compile an XML scene, going through the MJB cache; NULL with error filled on failure. Safe off the main thread.
+mjModel *
+compile_scene(const world *w, const char *xml, bool *from_cache, char *error, i32 error_size)
+{
+    u64 key = hash_bytes(xml, strlen(xml), HASH_SEED);
+    i32 version = mj_version();
+    i32 num_size = sizeof(mjtNum);
+    key = hash_bytes(&version, sizeof(version), key);
+    key = hash_bytes(&num_size, sizeof(num_size), key);
+    char path[300];
+    snprintf(path, sizeof(path), "%s/model-%016llx.mjb", w->cache_dir, (unsigned long long)key);
+
+    *from_cache = false;
+    mjModel *m = NULL;
+    if (w->model_cache && access(path, R_OK) == 0)
+    {
+        m = mj_loadModel(path, NULL);
+        *from_cache = m != NULL;
+        if (!m) fprintf(stderr, "model cache: cannot load %s, recompiling\n", path);
+    }
+    if (m) return m;
+
+    mjSpec *spec = mj_parseXMLString(xml, NULL, error, error_size);
+    if (!spec) return NULL;
+    m = mj_compile(spec, NULL);
+    if (!m) snprintf(error, error_size, "%s", mjs_getError(spec));
+    mj_deleteSpec(spec);
+    if (!m) return NULL;
+
+    if (w->model_cache)
+    {
+        // unique per process and per call, as vecenv_create may run on several threads at once
+        static std::atomic<u32> tmp_seq;
+        char tmp[340];
+        snprintf(tmp, sizeof(tmp), "%s.%d.%u.tmp", path, (i32)getpid(), tmp_seq.fetch_add(1));
+        mkdir(w->cache_dir, 0755);
+        mj_saveModel(m, tmp, NULL, 0);
+        if (rename(tmp, path) != 0)
+        {
+            fprintf(stderr, "model cache: cannot write %s\n", path);
+            unlink(tmp);
+        }
+    }
+    return m;
+}
+
+// whole file as a NUL-terminated malloc'd string, NULL if unreadable
+char *
+read_text_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = size >= 0 ? (char *)malloc(size + 1) : NULL;
+    if (text && fread(text, 1, size, f) != (size_t)size)
+    {
+        free(text);
+        text = NULL;
+    }
+    if (text) text[size] = 0;
+    fclose(f);
+    return text;
+}
+
+// the model comes from scene_path when given (and is then hot-reloaded, see reload.cpp), else from scene[]
+void
+load_model(world *w)
+{
+    char *file_xml = w->scene_path[0] ? read_text_file(w->scene_path) : NULL;
+    if (w->scene_path[0] && !file_xml) fprintf(stderr, "model: cannot read %s, using the built-in scene\n", w->scene_path);
+    char error[1000];
+    w->model = compile_scene(w, file_xml ? file_xml : scene, &w->model_from_cache, error, sizeof(error));
+    if (!w->model) fprintf(stderr, "model: %s\n", error);
+    free(file_xml);
+    assert(w->model);
+    w->data = mj_makeData(w->model);
+    assert(w->data);
+    w->model_hash = model_hash(w->model);
+}
+
+void
+startup_begin(world *w)
+{
+    w->startup_start_ns = w->startup_mark_ns = now_ns();
+    w->startup_nstages = 0;
+}
+
+// time since the previous mark, attributed to stage
+void
+startup_mark(world *w, const char *stage)
+{
+    i64 now = now_ns();
+    if (w->startup_nstages < STARTUP_MAX_STAGES)
+    {
+        w->startup_stage[w->startup_nstages] = stage;
+        w->startup_ms[w->startup_nstages] = (now - w->startup_mark_ns) / 1e6;
+        w->startup_nstages++;
+    }
+    w->startup_mark_ns = now;
+}
+
+void
+startup_report(world *w)
+{
+    printf("startup: %.1f ms total (model %s)", (w->startup_mark_ns - w->startup_start_ns) / 1e6, w->model_from_cache ? "from cache" : "compiled");
+    for (i32 i = 0; i < w->startup_nstages; i++)
+        printf(", %s %.1f ms", w->startup_stage[i], w->startup_ms[i]);
+    printf("\n");
+}
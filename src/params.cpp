@@ -0,0 +1,312 @@
+#include "base.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+// Physical parameter edits (pole mass and length, platform mass) from the panel. The scene is parsed into an mjSpec on
+// the first edit and kept; each edit changes pole_geom and platform_geom in it and recompiles into the live mjModel and
+// mjData with mj_recompile, which keeps the simulation state, so nothing is reparsed. The gain is then looked up in the
+// synthesis cache, and on a miss relinearized and solved on a background thread against a copy of the edited model,
+// while the old K keeps balancing the new plant. Edits made while a solve runs are coalesced into one more solve.
+
+enum params_phase
+{
+    PARAMS_IDLE,
+    PARAMS_SOLVING, // main -> worker: job filled in
+    PARAMS_READY,   // worker -> main: result filled in
+};
+
+typedef struct params_state {
+    mjSpec *spec; // NULL until the first edit, and again after a hot reload
+    mjsGeom *pole_geom;
+    mjsGeom *platform_geom;
+    f64 initial[3]; // pole mass, pole length, platform mass as loaded
+    bool dirty;     // the live model changed since the gain was last matched to it
+    bool stale;     // the job model belongs to a replaced model, free it when the worker hands it back
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool quit;
+    std::atomic<i32> phase;
+    world job; // scratch world: copy of the edited model, Q and R; owned by whichever side the phase says
+    gain_entry result;
+    bool solved;
+
+    f64 parse_ms;
+    f64 recompile_ms;
+    f64 solve_ms;
+    u64 edits;
+    char status[256];
+} params_state;
+
+void init_params(world *w);
+void destroy_params(world *w);
+void params_reset(world *w);
+void params_apply(world *w);
+void params_restore(world *w);
+void params_poll(world *w);
+
+void
+params_worker(params_state *ps)
+{
+    std::unique_lock<std::mutex> guard(ps->lock);
+    while (!ps->quit)
+    {
+        if (ps->phase.load(std::memory_order_acquire) != PARAMS_SOLVING)
+        {
+            ps->wake.wait(guard);
+            continue;
+        }
+        guard.unlock();
+        i64 start = now_ns();
+        mj_resetData(ps->job.model, ps->job.data);
+        ps->solved = synthesize_lqr(&ps->job, ps->job.Q, ps->job.R, &ps->result);
+        ps->solve_ms = (now_ns() - start) / 1e6;
+        guard.lock();
+        ps->phase.store(PARAMS_READY, std::memory_order_release);
+    }
+}
+
+// slider values from the compiled model: body masses and the capsule length of the named geoms
+void
+params_read_model(world *w)
+{
+    const mjModel *m = w->model;
+    i32 pole = mj_name2id(m, mjOBJ_GEOM, "pole_geom");
+    i32 platform = mj_name2id(m, mjOBJ_GEOM, "platform_geom");
+    w->pole_mass = pole >= 0 ? m->body_mass[m->geom_bodyid[pole]] : 0.0;
+    w->pole_length = pole >= 0 ? 2.0 * m->geom_size[3 * pole + 1] : 0.0;
+    w->platform_mass = platform >= 0 ? m->body_mass[m->geom_bodyid[platform]] : 0.0;
+    params_state *ps = w->params;
+    ps->initial[0] = w->pole_mass;
+    ps->initial[1] = w->pole_length;
+    ps->initial[2] = w->platform_mass;
+}
+
+void
+init_params(world *w)
+{
+    params_state *ps = new params_state();
+    snprintf(ps->status, sizeof(ps->status), "as loaded");
+    ps->worker = std::thread(params_worker, ps);
+    w->params = ps;
+    params_read_model(w);
+}
+
+void
+destroy_params(world *w)
+{
+    params_state *ps = w->params;
+    if (!ps) return;
+    {
+        std::lock_guard<std::mutex> guard(ps->lock);
+        ps->quit = true;
+    }
+    ps->wake.notify_one();
+    ps->worker.join();
+    if (ps->job.data) mj_deleteData(ps->job.data);
+    if (ps->job.model) mj_deleteModel(ps->job.model);
+    if (ps->spec) mj_deleteSpec(ps->spec);
+    delete ps;
+    w->params = NULL;
+}
+
+// the model was replaced (hot reload): forget the spec and everything derived from the old model
+void
+params_reset(world *w)
+{
+    params_state *ps = w->params;
+    if (!ps) return;
+    if (ps->spec) mj_deleteSpec(ps->spec);
+    ps->spec = NULL;
+    ps->pole_geom = NULL;
+    ps->platform_geom = NULL;
+    ps->dirty = false;
+    if (ps->phase.load(std::memory_order_acquire) == PARAMS_SOLVING)
+    {
+        ps->stale = true;
+    }
+    else
+    {
+        if (ps->job.data) mj_deleteData(ps->job.data);
+        if (ps->job.model) mj_deleteModel(ps->job.model);
+        ps->job.data = NULL;
+        ps->job.model = NULL;
+        ps->phase.store(PARAMS_IDLE, std::memory_order_relaxed);
+    }
+    params_read_model(w);
+    snprintf(ps->status, sizeof(ps->status), "as loaded");
+}
+
+// parse the scene the live model came from; false with status set when it cannot be edited
+bool
+params_parse(world *w)
+{
+    params_state *ps = w->params;
+    i64 start = now_ns();
+    char *file_xml = w->scene_path[0] ? read_text_file(w->scene_path) : NULL;
+    char error[200];
+    ps->spec = mj_parseXMLString(file_xml ? file_xml : scene, NULL, error, sizeof(error));
+    free(file_xml);
+    if (!ps->spec)
+    {
+        snprintf(ps->status, sizeof(ps->status), "cannot parse the scene: %s", error);
+        return false;
+    }
+    mjsElement *pole = mjs_findElement(ps->spec, mjOBJ_GEOM, "pole_geom");
+    mjsElement *platform = mjs_findElement(ps->spec, mjOBJ_GEOM, "platform_geom");
+    if (!pole || !platform)
+    {
+        snprintf(ps->status, sizeof(ps->status), "the scene has no pole_geom or platform_geom to edit");
+        mj_deleteSpec(ps->spec);
+        ps->spec = NULL;
+        return false;
+    }
+    ps->pole_geom = mjs_asGeom(pole);
+    ps->platform_geom = mjs_asGeom(platform);
+    ps->parse_ms = (now_ns() - start) / 1e6;
+    return true;
+}
+
+// set the capsule/cylinder length, along fromto when the geom is given that way
+void
+params_set_length(mjsGeom *g, f64 length)
+{
+    if (isnan(g->fromto[0]))
+    {
+        g->size[1] = 0.5 * length;
+        return;
+    }
+    f64 axis[3] = { g->fromto[3] - g->fromto[0], g->fromto[4] - g->fromto[1], g->fromto[5] - g->fromto[2] };
+    f64 scale = length / mjMAX(mju_norm3(axis), mjMINVAL);
+    for (i32 i = 0; i < 3; i++)
+        g->fromto[3 + i] = g->fromto[i] + scale * axis[i];
+}
+
+// write the slider values into the spec and recompile the live model in place
+void
+params_apply(world *w)
+{
+    params_state *ps = w->params;
+    if (!ps->spec && !params_parse(w)) return;
+
+    i64 start = now_ns();
+    // explicit masses, so the length slider does not move the mass through the density
+    ps->pole_geom->mass = w->pole_mass;
+    ps->platform_geom->mass = w->platform_mass;
+    params_set_length(ps->pole_geom, w->pole_length);
+    if (mj_recompile(ps->spec, NULL, w->model, w->data) != 0)
+    {
+        snprintf(ps->status, sizeof(ps->status), "recompile failed: %.200s", mjs_getError(ps->spec));
+        return;
+    }
+    mj_forward(w->model, w->data);
+    u64 old_hash = w->model_hash;
+    w->model_hash = model_hash(w->model);
+    // the log's header holds the model hash it was recorded with
+    if (w->recorder && w->model_hash != old_hash)
+    {
+        fprintf(stderr, "params: model changed, stopping telemetry recording\n");
+        telemetry_stop(w);
+    }
+    ps->recompile_ms = (now_ns() - start) / 1e6;
+    ps->edits++;
+
+    // a configuration seen before (this run or an earlier one) needs no solve
+    if (lqr_from_cache(w))
+    {
+        ps->dirty = false;
+        snprintf(ps->status, sizeof(ps->status), "recompiled in %.2f ms, gain from the cache", ps->recompile_ms);
+        return;
+    }
+    ps->dirty = true;
+    snprintf(ps->status, sizeof(ps->status), "recompiled in %.2f ms, relinearizing with the old K in control", ps->recompile_ms);
+}
+
+void
+params_restore(world *w)
+{
+    params_state *ps = w->params;
+    w->pole_mass = ps->initial[0];
+    w->pole_length = ps->initial[1];
+    w->platform_mass = ps->initial[2];
+    params_apply(w);
+}
+
+// main thread, once per frame: take a finished solve, and start one for the latest edit when the worker is free
+void
+params_poll(world *w)
+{
+    params_state *ps = w->params;
+    if (!ps) return;
+    i32 phase = ps->phase.load(std::memory_order_acquire);
+    if (phase == PARAMS_SOLVING) return;
+    if (phase == PARAMS_READY)
+    {
+        if (ps->stale)
+        {
+            mj_deleteData(ps->job.data);
+            mj_deleteModel(ps->job.model);
+            ps->job.data = NULL;
+            ps->job.model = NULL;
+            ps->stale = false;
+        }
+        else if (ps->solved)
+        {
+            w->gain_recomputes++;
+            // always worth keeping; only applied if nothing moved on since it was started
+            gain_insert(w, &ps->result);
+            f64 q[nstate];
+            for (i32 i = 0; i < nstate; i++)
+                q[i] = w->Q(i, i);
+            if (ps->result.model_hash == w->model_hash && gain_distance(&ps->result, q, w->R) == 0.0)
+            {
+                apply_gain_entry(w, &ps->result, GAIN_SOLVED);
+                snprintf(ps->status, sizeof(ps->status), "recompiled in %.2f ms, relinearized and solved in %.2f ms in the background",
+                         ps->recompile_ms, ps->solve_ms);
+            }
+        }
+        else
+        {
+            w->gain_recomputes++;
+            w->care_failures++;
+            snprintf(ps->status, sizeof(ps->status), "CARE failed for the edited model, keeping the old gain");
+        }
+        ps->phase.store(PARAMS_IDLE, std::memory_order_relaxed);
+    }
+    if (!ps->dirty) return;
+
+    // parameter edits never change the model sizes, so the job model is copied into in place after the first time
+    ps->dirty = false;
+    world *job = &ps->job;
+    if (!job->model)
+    {
+        job->model = mj_copyModel(NULL, w->model);
+        job->data = mj_makeData(job->model);
+    }
+    else
+    {
+        mj_copyModel(job->model, w->model);
+    }
+    job->model_hash = w->model_hash;
+    job->gains = NULL; // the gain cache belongs to the main thread
+    job->platform_x_qpos_id = w->platform_x_qpos_id;
+    job->platform_y_qpos_id = w->platform_y_qpos_id;
+    job->platform_x_qvel_id = w->platform_x_qvel_id;
+    job->platform_y_qvel_id = w->platform_y_qvel_id;
+    job->hinge_x_qpos_id = w->hinge_x_qpos_id;
+    job->hinge_y_qpos_id = w->hinge_y_qpos_id;
+    job->hinge_x_qvel_id = w->hinge_x_qvel_id;
+    job->hinge_y_qvel_id = w->hinge_y_qvel_id;
+    job->Q = w->Q;
+    job->R = w->R;
+    {
+        std::lock_guard<std::mutex> guard(ps->lock);
+        ps->phase.store(PARAMS_SOLVING, std::memory_order_release);
+    }
+    ps->wake.notify_one();
+}
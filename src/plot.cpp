@@ -0,0 +1,173 @@
+#include "base.hpp"
+#include <float.h>
+#include <string.h>
+
+// Scrolling history of the live sim for the panel plots. Every physics step appends one sample per channel to level 0
+// of a min/max pyramid; level k holds the min and max of each aligned run of 2^k samples and gets a new entry whenever
+// two entries of level k-1 complete, so pushing is O(1) amortized and allocation-free. Every level is a ring covering
+// the same PLOT_CAPACITY samples. Drawing picks the coarsest level that still has about one entry per pixel, so the
+// work per frame depends on the plot width, not on the sample rate or the length of the window.
+
+#define PLOT_CAPACITY (1 << 16) // level 0 samples, about a minute at 1 kHz
+#define PLOT_LEVELS 12
+#define PLOT_MAX_WIDTH 2048
+
+enum plot_channel
+{
+    PLOT_ANGLE_X,
+    PLOT_ANGLE_Y,
+    PLOT_POSITION_X,
+    PLOT_POSITION_Y,
+    PLOT_FORCE_X,
+    PLOT_FORCE_Y,
+    PLOT_CHANNELS,
+};
+
+typedef struct plot_level {
+    f64 *time; // time of the first sample of each entry
+    f32 *lo[PLOT_CHANNELS];
+    f32 *hi[PLOT_CHANNELS];
+    u32 mask; // ring capacity - 1
+} plot_level;
+
+typedef struct plot_history {
+    plot_level levels[PLOT_LEVELS];
+    u64 count; // level 0 samples pushed; level k has count >> k complete entries
+} plot_history;
+
+void init_plots(world *w);
+void destroy_plots(world *w);
+void plot_push(world *w);
+i32 plot_decimate(world *w, i32 channel, f64 seconds, i32 width, f32 *lo, f32 *hi);
+
+void
+init_plots(world *w)
+{
+    plot_history *ph = new plot_history();
+    for (i32 k = 0; k < PLOT_LEVELS; k++)
+    {
+        plot_level *l = &ph->levels[k];
+        u32 capacity = PLOT_CAPACITY >> k;
+        l->mask = capacity - 1;
+        l->time = new f64[capacity];
+        for (i32 c = 0; c < PLOT_CHANNELS; c++)
+        {
+            l->lo[c] = new f32[capacity];
+            l->hi[c] = new f32[capacity];
+        }
+    }
+    w->plots = ph;
+}
+
+void
+destroy_plots(world *w)
+{
+    plot_history *ph = w->plots;
+    if (!ph) return;
+    for (i32 k = 0; k < PLOT_LEVELS; k++)
+    {
+        delete[] ph->levels[k].time;
+        for (i32 c = 0; c < PLOT_CHANNELS; c++)
+        {
+            delete[] ph->levels[k].lo[c];
+            delete[] ph->levels[k].hi[c];
+        }
+    }
+    delete ph;
+    w->plots = NULL;
+}
+
+// hot path: called after every physics step
+void
+plot_push(world *w)
+{
+    plot_history *ph = w->plots;
+    if (!ph) return;
+    f64 time = w->data->time;
+    plot_level *l0 = &ph->levels[0];
+    if (ph->count && time < l0->time[(ph->count - 1) & l0->mask]) ph->count = 0; // sim was reset or rewound
+
+    Eigen::Matrix<f64, nstate, 1> x, y;
+    read_state_from_data(w, w->data, x, y);
+    f32 v[PLOT_CHANNELS];
+    v[PLOT_ANGLE_X] = (f32)x(1);
+    v[PLOT_ANGLE_Y] = (f32)y(1);
+    v[PLOT_POSITION_X] = (f32)x(0);
+    v[PLOT_POSITION_Y] = (f32)y(0);
+    v[PLOT_FORCE_X] = (f32)w->data->ctrl[0];
+    v[PLOT_FORCE_Y] = (f32)w->data->ctrl[1];
+
+    u64 i = ph->count & l0->mask;
+    l0->time[i] = time;
+    for (i32 c = 0; c < PLOT_CHANNELS; c++)
+        l0->lo[c][i] = l0->hi[c][i] = v[c];
+    ph->count++;
+
+    // merge pairs upwards while this sample completes an entry of the next level
+    for (i32 k = 1; k < PLOT_LEVELS && !(ph->count & ((1ull << k) - 1)); k++)
+    {
+        plot_level *below = &ph->levels[k - 1];
+        plot_level *l = &ph->levels[k];
+        u64 j = (ph->count >> k) - 1;
+        u64 a = (2 * j) & below->mask;
+        u64 b = (2 * j + 1) & below->mask;
+        l->time[j & l->mask] = below->time[a];
+        for (i32 c = 0; c < PLOT_CHANNELS; c++)
+        {
+            l->lo[c][j & l->mask] = mjMIN(below->lo[c][a], below->lo[c][b]);
+            l->hi[c][j & l->mask] = mjMAX(below->hi[c][a], below->hi[c][b]);
+        }
+    }
+}
+
+// Reduce the last `seconds` of a channel to per-pixel min/max over `width` columns ending at the newest sample.
+// Columns without samples get lo > hi. Returns the number of pyramid entries visited, at most about 2 * width.
+i32
+plot_decimate(world *w, i32 channel, f64 seconds, i32 width, f32 *lo, f32 *hi)
+{
+    for (i32 p = 0; p < width; p++)
+    {
+        lo[p] = FLT_MAX;
+        hi[p] = -FLT_MAX;
+    }
+    plot_history *ph = w->plots;
+    if (!ph || !ph->count || width <= 0) return 0;
+
+    // first level 0 sample inside the window, by bisection over the ring
+    const plot_level *l0 = &ph->levels[0];
+    u64 oldest = ph->count > PLOT_CAPACITY ? ph->count - PLOT_CAPACITY : 0;
+    f64 t_end = l0->time[(ph->count - 1) & l0->mask];
+    f64 t_begin = t_end - seconds;
+    u64 first = oldest;
+    u64 last = ph->count;
+    while (first < last)
+    {
+        u64 mid = first + (last - first) / 2;
+        if (l0->time[mid & l0->mask] < t_begin)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    // coarsest level with at least one entry per pixel
+    i32 k = 0;
+    while (k + 1 < PLOT_LEVELS && ((ph->count - first) >> (k + 1)) >= (u64)width)
+        k++;
+
+    f64 scale = width / seconds;
+    i32 visited = 0;
+    auto accumulate = [&](const plot_level *l, u64 j) {
+        i32 p = (i32)((l->time[j & l->mask] - t_begin) * scale);
+        p = mjMAX(0, mjMIN(width - 1, p));
+        lo[p] = mjMIN(lo[p], l->lo[channel][j & l->mask]);
+        hi[p] = mjMAX(hi[p], l->hi[channel][j & l->mask]);
+        visited++;
+    };
+    for (u64 j = first >> k; j < ph->count >> k; j++)
+        accumulate(&ph->levels[k], j);
+    // the newest samples are not part of a complete level k entry yet: at most one entry from each finer level
+    for (i32 m = k - 1; m >= 0; m--)
+        for (u64 j = (ph->count >> (m + 1)) << 1; j < ph->count >> m; j++)
+            accumulate(&ph->levels[m], j);
+    return visited;
+}
@@ -0,0 +1,312 @@
+#include "base.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <libgen.h>
+#include <mutex>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// Hot reload of the scene file given with --scene. A watcher thread waits on inotify for the file (watching its
+// directory, since editors usually save by renaming a new file over the old one), then compiles it on that thread.
+// Linearizing needs the live Q and R, so the main thread hands those over on its next frame, taking the gain from the
+// synthesis cache when the new model was seen before; otherwise the worker relinearizes and solves the CARE on a scratch
+// world. Only the finished result is swapped in on the main thread, which also owns the cache and records a new
+// synthesis there: the new mjModel, an mjData seeded with the state of every joint that kept its name and size, the
+// joint ids, and A, B, K.
+// A model that fails to compile leaves the running one untouched.
+
+#define RELOAD_DEBOUNCE_MS 50
+
+enum reload_phase
+{
+    RELOAD_IDLE,
+    RELOAD_COMPILED,  // worker -> main: model compiled, waiting for Q and R
+    RELOAD_LINEARIZE, // main -> worker: Q and R filled in
+    RELOAD_READY,     // worker -> main: swap it in
+};
+
+typedef struct reload_state {
+    char path[256];
+    std::thread worker;
+    std::atomic<bool> quit;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<i32> phase;
+    world next; // scratch world for the new model, owned by whichever side the phase says
+    bool cached;      // next has its gain from the cache, nothing to solve
+    bool solved;      // otherwise: the CARE of entry succeeded
+    gain_entry entry; // the worker's synthesis, for the main thread's cache
+    u64 reloads;
+    f64 last_ms; // compile + linearize of the last reload
+    char status[256];
+} reload_state;
+
+void init_reload(world *w);
+void destroy_reload(world *w);
+void reload_poll(world *w);
+void reload_status(world *w, char *out, i32 size);
+
+// compile, then wait for Q and R from the main thread and linearize
+void
+reload_build(reload_state *rs, const world *live)
+{
+    i64 start = now_ns();
+    char *xml = read_text_file(rs->path);
+    if (!xml)
+    {
+        std::lock_guard<std::mutex> guard(rs->lock);
+        snprintf(rs->status, sizeof(rs->status), "cannot read %.200s", rs->path);
+        return;
+    }
+    char error[200];
+    bool from_cache;
+    mjModel *m = compile_scene(live, xml, &from_cache, error, sizeof(error));
+    free(xml);
+    if (!m)
+    {
+        std::lock_guard<std::mutex> guard(rs->lock);
+        snprintf(rs->status, sizeof(rs->status), "compile failed: %s", error);
+        fprintf(stderr, "reload: %s\n", rs->status);
+        return;
+    }
+    // the controller needs these joints; resolve_joint_ids would assert on a model without them
+    for (const char *joint : { "platform_x", "platform_y", "hinge_x", "hinge_y" })
+    {
+        if (mj_name2id(m, mjOBJ_JOINT, joint) >= 0) continue;
+        std::lock_guard<std::mutex> guard(rs->lock);
+        snprintf(rs->status, sizeof(rs->status), "new model has no joint '%s', keeping the old one", joint);
+        mj_deleteModel(m);
+        return;
+    }
+
+    world *next = &rs->next;
+    next->model = m;
+    next->data = mj_makeData(m);
+    next->model_hash = model_hash(m);
+    next->gains = NULL; // the gain cache belongs to the main thread
+    resolve_joint_ids(next);
+
+    std::unique_lock<std::mutex> guard(rs->lock);
+    rs->phase.store(RELOAD_COMPILED, std::memory_order_release);
+    rs->wake.wait(guard, [&] { return rs->quit.load() || rs->phase.load() == RELOAD_LINEARIZE; });
+    if (rs->quit.load()) return;
+    guard.unlock();
+
+    if (!rs->cached)
+    {
+        rs->solved = synthesize_lqr(next, next->Q, next->R, &rs->entry);
+        next->gain_recomputes++;
+        if (!rs->solved)
+        {
+            next->care_failures++;
+            fprintf(stderr, "reload: CARE failed for the new model, keeping the old gain\n");
+        }
+    }
+    rs->last_ms = (now_ns() - start) / 1e6;
+    rs->phase.store(RELOAD_READY, std::memory_order_release);
+}
+
+void
+reload_watch(reload_state *rs, const world *live)
+{
+#ifdef __linux__
+    char dir_buf[256], name_buf[256];
+    snprintf(dir_buf, sizeof(dir_buf), "%s", rs->path);
+    snprintf(name_buf, sizeof(name_buf), "%s", rs->path);
+    const char *dir = dirname(dir_buf);
+    const char *name = basename(name_buf);
+
+    i32 fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        fprintf(stderr, "reload: cannot watch %s\n", dir);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char events[4096];
+    bool changed = false;
+    while (!rs->quit.load())
+    {
+        // block for events; once one arrived, wait for a quiet period so a burst of writes is one reload
+        pollfd p = { fd, POLLIN, 0 };
+        i32 ready = poll(&p, 1, changed ? RELOAD_DEBOUNCE_MS : 200);
+        if (ready > 0)
+        {
+            ssize_t n = read(fd, events, sizeof(events));
+            for (char *e = events; e < events + mjMAX(n, 0);)
+            {
+                inotify_event *ev = (inotify_event *)e;
+                if (ev->len && !strcmp(ev->name, name)) changed = true;
+                e += sizeof(inotify_event) + ev->len;
+            }
+            continue;
+        }
+        if (!changed || rs->phase.load(std::memory_order_acquire) != RELOAD_IDLE) continue;
+        changed = false;
+        reload_build(rs, live);
+    }
+    close(fd);
+#else
+    fprintf(stderr, "reload: file watching needs inotify, %s will not be reloaded\n", rs->path);
+#endif
+}
+
+void
+init_reload(world *w)
+{
+    if (!w->scene_path[0]) return;
+    reload_state *rs = new reload_state();
+    snprintf(rs->path, sizeof(rs->path), "%s", w->scene_path);
+    snprintf(rs->status, sizeof(rs->status), "watching %.200s", rs->path);
+    rs->worker = std::thread(reload_watch, rs, (const world *)w);
+    w->reload = rs;
+}
+
+void
+destroy_reload(world *w)
+{
+    reload_state *rs = w->reload;
+    if (!rs) return;
+    {
+        std::lock_guard<std::mutex> guard(rs->lock);
+        rs->quit.store(true);
+    }
+    rs->wake.notify_one();
+    rs->worker.join();
+    if (rs->next.data) mj_deleteData(rs->next.data);
+    if (rs->next.model) mj_deleteModel(rs->next.model);
+    delete rs;
+    w->reload = NULL;
+}
+
+// copy qpos/qvel of every joint whose name and sizes match, plus time and, if the actuators match, ctrl
+void
+reload_carry_state(const mjModel *m0, const mjData *d0, const mjModel *m1, mjData *d1)
+{
+    for (i32 j = 0; j < m1->njnt; j++)
+    {
+        const char *name = mj_id2name(m1, mjOBJ_JOINT, j);
+        i32 k = name ? mj_name2id(m0, mjOBJ_JOINT, name) : -1;
+        if (k < 0 || m0->jnt_type[k] != m1->jnt_type[j]) continue;
+        i32 nq = m1->jnt_type[j] == mjJNT_FREE ? 7 : m1->jnt_type[j] == mjJNT_BALL ? 4 : 1;
+        i32 nv = m1->jnt_type[j] == mjJNT_FREE ? 6 : m1->jnt_type[j] == mjJNT_BALL ? 3 : 1;
+        mju_copy(d1->qpos + m1->jnt_qposadr[j], d0->qpos + m0->jnt_qposadr[k], nq);
+        mju_copy(d1->qvel + m1->jnt_dofadr[j], d0->qvel + m0->jnt_dofadr[k], nv);
+    }
+    if (m0->nu == m1->nu) mju_copy(d1->ctrl, d0->ctrl, m1->nu);
+    d1->time = d0->time;
+    mj_forward(m1, d1);
+}
+
+// main thread, once per frame: hand Q and R to the worker, or swap in a finished model
+void
+reload_poll(world *w)
+{
+    reload_state *rs = w->reload;
+    if (!rs) return;
+    i32 phase = rs->phase.load(std::memory_order_acquire);
+    if (phase == RELOAD_COMPILED)
+    {
+        {
+            std::lock_guard<std::mutex> guard(rs->lock);
+            rs->next.Q = w->Q;
+            rs->next.R = w->R;
+            rs->next.K = w->K;
+            // the worker is waiting, so next can borrow the main thread's cache for the lookup
+            rs->next.gains = w->gains;
+            rs->next.use_gain_cache = w->use_gain_cache;
+            rs->next.gain_tolerance = w->gain_tolerance;
+            rs->cached = lqr_from_cache(&rs->next);
+            rs->next.gains = NULL;
+            rs->phase.store(RELOAD_LINEARIZE, std::memory_order_release);
+        }
+        rs->wake.notify_one();
+        return;
+    }
+    if (phase != RELOAD_READY) return;
+
+    world *next = &rs->next;
+    reload_carry_state(w->model, w->data, next->model, next->data);
+    bool same_layout = next->model->nq == w->model->nq && next->model->nv == w->model->nv &&
+                       mj_stateSize(next->model, TELEMETRY_KEYFRAME_SIG) == mj_stateSize(w->model, TELEMETRY_KEYFRAME_SIG);
+
+    // everything that holds pointers into or sizes of the old model; a log's header and keyframes describe one model
+    replay_close(w);
+    if (w->recorder && (!same_layout || next->model_hash != w->model_hash))
+    {
+        fprintf(stderr, "reload: %s, stopping telemetry recording\n", same_layout ? "model changed" : "state size changed");
+        telemetry_stop(w);
+    }
+    mjModel *old_model = w->model;
+    mjData *old_data = w->data;
+    w->model = next->model;
+    w->data = next->data;
+    set_control_callback(w, w->control_in_mujoco);
+    w->model_hash = next->model_hash;
+    w->platform_x_qpos_id = next->platform_x_qpos_id;
+    w->platform_y_qpos_id = next->platform_y_qpos_id;
+    w->platform_x_qvel_id = next->platform_x_qvel_id;
+    w->platform_y_qvel_id = next->platform_y_qvel_id;
+    w->hinge_x_qpos_id = next->hinge_x_qpos_id;
+    w->hinge_y_qpos_id = next->hinge_y_qpos_id;
+    w->hinge_x_qvel_id = next->hinge_x_qvel_id;
+    w->hinge_y_qvel_id = next->hinge_y_qvel_id;
+    if (rs->cached)
+    {
+        w->A = next->A;
+        w->B = next->B;
+        w->K = next->K;
+        w->gain_source = next->gain_source;
+    }
+    else if (rs->solved)
+    {
+        apply_gain_entry(w, &rs->entry, GAIN_SOLVED);
+        gain_insert(w, &rs->entry);
+    }
+    else
+    {
+        // the new linearization, but K and its source stay those of the old model
+        w->A = Eigen::Map<const Eigen::Matrix<f64, nstate, nstate> >(rs->entry.A);
+        w->B = Eigen::Map<const Eigen::Matrix<f64, nstate, nact> >(rs->entry.B);
+    }
+    w->gain_recomputes += next->gain_recomputes;
+    w->care_failures += next->care_failures;
+    next->gain_recomputes = 0;
+    next->care_failures = 0;
+    update_poles(w);
+    read_state_from_sim(w, w->x, w->y);
+    params_reset(w);
+
+    destroy_rewind(w);
+    init_rewind(w);
+    destroy_fleet(w);
+    init_fleet(w);
+    mjv_freeScene(&w->scene);
+    mjv_makeScene(w->model, &w->scene, scene_max_geoms(w));
+    mjr_freeContext(&w->context);
+    mjr_makeContext(w->model, &w->context, mjFONTSCALE_150);
+    mj_deleteData(old_data);
+    mj_deleteModel(old_model);
+
+    std::lock_guard<std::mutex> guard(rs->lock);
+    next->model = NULL;
+    next->data = NULL;
+    rs->reloads++;
+    snprintf(rs->status, sizeof(rs->status), "reloaded %.200s (%llu), %.1f ms in the background", rs->path, (unsigned long long)rs->reloads,
+             rs->last_ms);
+    rs->phase.store(RELOAD_IDLE, std::memory_order_release);
+}
+
+void
+reload_status(world *w, char *out, i32 size)
+{
+    std::lock_guard<std::mutex> guard(w->reload->lock);
+    snprintf(out, size, "%s", w->reload->status);
+}
@@ -0,0 +1,147 @@
+#include "base.hpp"
+#include <stdio.h>
+
+// Replay of a recorded telemetry log. Scrubbing interpolates the logged qpos/qvel into a separate mjData for display;
+// resuming restores the nearest earlier keyframe into the live mjData and re-simulates at most one keyframe interval
+// with the logged controls.
+
+typedef struct replay_state {
+    telemetry_reader reader;
+    mjData *data;
+    f64 time;
+    f64 t_begin;
+    f64 t_end;
+    bool playing;
+    f32 speed;
+} replay_state;
+
+bool replay_open(world *w, const char *path);
+void replay_close(world *w);
+void replay_seek(world *w, f64 time);
+void replay_advance(world *w);
+void replay_resume(world *w);
+
+bool
+replay_open(world *w, const char *path)
+{
+    replay_close(w);
+    replay_state *rs = new replay_state();
+    if (!telemetry_reader_open(&rs->reader, path) || !rs->reader.nsamples)
+    {
+        fprintf(stderr, "replay: cannot read %s\n", path);
+        delete rs;
+        return false;
+    }
+    telemetry_header *h = &rs->reader.header;
+    if ((i32)h->nq != w->model->nq || (i32)h->nv != w->model->nv)
+    {
+        fprintf(stderr, "replay: %s was recorded with a different model (nq %u nv %u)\n", path, h->nq, h->nv);
+        telemetry_reader_close(&rs->reader);
+        delete rs;
+        return false;
+    }
+    if (h->model_hash != w->model_hash) fprintf(stderr, "replay: model hash differs from %s, keyframes may not match\n", path);
+
+    rs->data = mj_makeData(w->model);
+    rs->t_begin = rs->reader.blocks.front().t_min;
+    rs->t_end = rs->reader.blocks.back().t_max;
+    rs->speed = 1.0f;
+    w->replay = rs;
+    replay_seek(w, rs->t_begin);
+    return true;
+}
+
+void
+replay_close(world *w)
+{
+    replay_state *rs = w->replay;
+    if (!rs) return;
+    w->replay = NULL;
+    telemetry_reader_close(&rs->reader);
+    mj_deleteData(rs->data);
+    delete rs;
+}
+
+void
+replay_seek(world *w, f64 time)
+{
+    replay_state *rs = w->replay;
+    telemetry_reader *r = &rs->reader;
+    time = mjMAX(rs->t_begin, mjMIN(rs->t_end, time));
+    rs->time = time;
+
+    f64 a[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    f64 b[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    u64 i = telemetry_reader_find(r, time);
+    telemetry_reader_sample(r, i, a);
+    if (i + 1 < r->nsamples)
+        telemetry_reader_sample(r, i + 1, b);
+    else
+        telemetry_reader_sample(r, i, b);
+
+    // linear interpolation between the two logged samples around time
+    f64 span = b[0] - a[0];
+    f64 alpha = span > 0 ? (time - a[0]) / span : 0;
+    alpha = mjMAX(0.0, mjMIN(1.0, alpha));
+    f64 v[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    for (u32 c = 0; c < r->header.ncol; c++)
+        v[c] = a[c] + alpha * (b[c] - a[c]);
+
+    for (i32 k = 0; k < nstate; k++)
+    {
+        w->x(k) = v[1 + k];
+        w->y(k) = v[1 + nstate + k];
+    }
+    w->ux = v[1 + 2 * nstate];
+    w->uy = v[2 + 2 * nstate];
+    mju_copy(rs->data->qpos, v + TELEMETRY_FIXED_COLS, r->header.nq);
+    mju_copy(rs->data->qvel, v + TELEMETRY_FIXED_COLS + r->header.nq, r->header.nv);
+    rs->data->time = time;
+    mj_forward(w->model, rs->data);
+}
+
+void
+replay_advance(world *w)
+{
+    replay_state *rs = w->replay;
+    if (!rs->playing) return;
+    f64 time = rs->time + rs->speed / w->render_hz;
+    if (time >= rs->t_end) rs->playing = false;
+    replay_seek(w, time);
+}
+
+// continue live simulation from the current replay time
+void
+replay_resume(world *w)
+{
+    replay_state *rs = w->replay;
+    telemetry_reader *r = &rs->reader;
+    const telemetry_keyframe *kf = telemetry_reader_keyframe(r, rs->time);
+    if (!kf || r->keys_header.sig != TELEMETRY_KEYFRAME_SIG || (i32)r->keys_header.state_size != mj_stateSize(w->model, TELEMETRY_KEYFRAME_SIG))
+    {
+        fprintf(stderr, "replay: no usable keyframe before t = %.3f\n", rs->time);
+        return;
+    }
+
+    // logged ctrl is what was applied over the step ending at the sample, so replay it step by step from the keyframe
+    set_control_callback(w, false);
+    mj_setState(w->model, w->data, kf->state, TELEMETRY_KEYFRAME_SIG);
+    f64 prev[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    f64 next[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    u64 i = telemetry_reader_find(r, kf->time);
+    telemetry_reader_sample(r, i, prev);
+    while (i + 1 < r->nsamples)
+    {
+        telemetry_reader_sample(r, i + 1, next);
+        if (next[0] > rs->time) break;
+        w->model->opt.timestep = next[0] - prev[0];
+        w->data->ctrl[0] = next[1 + 2 * nstate];
+        w->data->ctrl[1] = next[2 + 2 * nstate];
+        mj_step(w->model, w->data);
+        mju_copy(prev, next, r->header.ncol);
+        i++;
+    }
+    mj_forward(w->model, w->data);
+    read_state_from_sim(w, w->x, w->y);
+    replay_close(w);
+}
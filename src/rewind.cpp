@@ -0,0 +1,243 @@
+#include "base.hpp"
+#include <string.h>
+
+// In-memory time-travel history of the live sim. Every physics step an mjSTATE_INTEGRATION snapshot is XOR-ed against
+// the previous one and stored as a control byte (leading/trailing zero byte counts) plus the remaining middle bytes.
+// Snapshots are grouped into chunks of REWIND_CHUNK_FRAMES whose first frame is encoded against zero, so restoring
+// decodes at most one chunk. Chunks live in a fixed arena and the oldest are evicted, so memory stays bounded.
+
+#define REWIND_SIG mjSTATE_INTEGRATION
+#define REWIND_CHUNK_FRAMES 64
+#define REWIND_ARENA_BYTES (16 << 20)
+#define REWIND_MAX_CHUNKS 8192
+#define REWIND_ZERO 0xff
+
+typedef struct rewind_chunk {
+    u64 offset;
+    u32 nbytes;
+    u32 nframes;
+    f64 t_first;
+    f64 t_last;
+} rewind_chunk;
+
+typedef struct rewind_buffer {
+    u8 *arena;
+    u64 chunk_capacity; // worst-case encoded size of a full chunk
+    rewind_chunk chunks[REWIND_MAX_CHUNKS];
+    u32 first; // oldest chunk in the ring
+    u32 count; // the newest chunk is the one being written
+    i32 state_size;
+    u64 *prev;
+    u64 *frame;
+    u64 frames;
+} rewind_buffer;
+
+void init_rewind(world *w);
+void destroy_rewind(world *w);
+void rewind_push(world *w);
+bool rewind_to(world *w, f64 time);
+void rewind_clear(world *w);
+u64 rewind_bytes(world *w);
+f64 rewind_oldest(world *w);
+
+u8 *
+rewind_encode(u8 *p, const u64 *cur, u64 *prev, i32 n)
+{
+    for (i32 i = 0; i < n; i++)
+    {
+        u64 x = cur[i] ^ prev[i];
+        prev[i] = cur[i];
+        if (!x)
+        {
+            *p++ = REWIND_ZERO;
+            continue;
+        }
+        i32 lead = __builtin_clzll(x) >> 3;
+        i32 trail = __builtin_ctzll(x) >> 3;
+        *p++ = (u8)((lead << 4) | trail);
+        x >>= 8 * trail;
+        for (i32 k = 0; k < 8 - lead - trail; k++)
+        {
+            *p++ = (u8)x;
+            x >>= 8;
+        }
+    }
+    return p;
+}
+
+const u8 *
+rewind_decode(const u8 *p, u64 *prev, i32 n)
+{
+    for (i32 i = 0; i < n; i++)
+    {
+        u8 ctrl = *p++;
+        if (ctrl == REWIND_ZERO) continue;
+        i32 lead = ctrl >> 4;
+        i32 trail = ctrl & 0xf;
+        u64 x = 0;
+        for (i32 k = 0; k < 8 - lead - trail; k++)
+            x |= (u64)(*p++) << (8 * k);
+        prev[i] ^= x << (8 * trail);
+    }
+    return p;
+}
+
+rewind_chunk *
+rewind_chunk_at(rewind_buffer *rb, u32 i)
+{
+    return &rb->chunks[(rb->first + i) % REWIND_MAX_CHUNKS];
+}
+
+void
+init_rewind(world *w)
+{
+    rewind_buffer *rb = new rewind_buffer();
+    rb->state_size = mj_stateSize(w->model, REWIND_SIG);
+    rb->chunk_capacity = (u64)REWIND_CHUNK_FRAMES * rb->state_size * 9;
+    rb->arena = new u8[REWIND_ARENA_BYTES];
+    rb->prev = new u64[rb->state_size];
+    rb->frame = new u64[rb->state_size];
+    w->rewind = rb;
+}
+
+void
+destroy_rewind(world *w)
+{
+    rewind_buffer *rb = w->rewind;
+    if (!rb) return;
+    delete[] rb->arena;
+    delete[] rb->prev;
+    delete[] rb->frame;
+    delete rb;
+    w->rewind = NULL;
+}
+
+void
+rewind_clear(world *w)
+{
+    w->rewind->first = 0;
+    w->rewind->count = 0;
+    w->rewind->frames = 0;
+}
+
+void
+rewind_evict(rewind_buffer *rb)
+{
+    rb->frames -= rewind_chunk_at(rb, 0)->nframes;
+    rb->first = (rb->first + 1) % REWIND_MAX_CHUNKS;
+    rb->count--;
+}
+
+// start a chunk with room for a worst-case encoding, evicting whatever old chunks overlap that room
+void
+rewind_new_chunk(rewind_buffer *rb)
+{
+    u64 offset = 0;
+    if (rb->count)
+    {
+        rewind_chunk *last = rewind_chunk_at(rb, rb->count - 1);
+        offset = last->offset + last->nbytes;
+    }
+    if (offset + rb->chunk_capacity > REWIND_ARENA_BYTES)
+    {
+        // wrap: chunks still sitting past the write position are the oldest ones, drop them first
+        while (rb->count && rewind_chunk_at(rb, 0)->offset >= offset)
+            rewind_evict(rb);
+        offset = 0;
+    }
+
+    while (rb->count)
+    {
+        rewind_chunk *oldest = rewind_chunk_at(rb, 0);
+        bool overlaps = oldest->offset < offset + rb->chunk_capacity && offset < oldest->offset + oldest->nbytes;
+        if (!overlaps && rb->count < REWIND_MAX_CHUNKS) break;
+        rewind_evict(rb);
+    }
+
+    rewind_chunk *c = rewind_chunk_at(rb, rb->count++);
+    c->offset = offset;
+    c->nbytes = 0;
+    c->nframes = 0;
+    memset(rb->prev, 0, sizeof(u64) * rb->state_size);
+}
+
+// hot path: called after every physics step, no allocation
+void
+rewind_push(world *w)
+{
+    rewind_buffer *rb = w->rewind;
+    if (!rb) return;
+    f64 time = w->data->time;
+    if (rb->count && time < rewind_chunk_at(rb, rb->count - 1)->t_last) rewind_clear(w); // sim was reset
+
+    if (!rb->count || rewind_chunk_at(rb, rb->count - 1)->nframes == REWIND_CHUNK_FRAMES) rewind_new_chunk(rb);
+    rewind_chunk *c = rewind_chunk_at(rb, rb->count - 1);
+
+    mj_getState(w->model, w->data, (mjtNum *)rb->frame, REWIND_SIG);
+    u8 *start = rb->arena + c->offset + c->nbytes;
+    u8 *end = rewind_encode(start, rb->frame, rb->prev, rb->state_size);
+    c->nbytes += (u32)(end - start);
+    if (!c->nframes) c->t_first = time;
+    c->t_last = time;
+    c->nframes++;
+    rb->frames++;
+}
+
+// restore the newest snapshot at or before time into the live mjData and drop everything after it
+bool
+rewind_to(world *w, f64 time)
+{
+    rewind_buffer *rb = w->rewind;
+    if (!rb || !rb->count) return false;
+
+    u32 ci = 0;
+    while (ci + 1 < rb->count && rewind_chunk_at(rb, ci + 1)->t_first <= time)
+        ci++;
+    rewind_chunk *c = rewind_chunk_at(rb, ci);
+
+    // decode forward through the chunk; frame holds the running decode, prev the last frame kept
+    memset(rb->frame, 0, sizeof(u64) * rb->state_size);
+    const u8 *p = rb->arena + c->offset;
+    u32 nframes = 0;
+    while (nframes < c->nframes)
+    {
+        const u8 *next = rewind_decode(p, rb->frame, rb->state_size);
+        f64 t;
+        memcpy(&t, &rb->frame[0], sizeof(t));
+        if (nframes && t > time) break;
+        memcpy(rb->prev, rb->frame, sizeof(u64) * rb->state_size);
+        p = next;
+        nframes++;
+    }
+
+    mj_setState(w->model, w->data, (const mjtNum *)rb->prev, REWIND_SIG);
+    mj_forward(w->model, w->data);
+    read_state_from_sim(w, w->x, w->y);
+
+    // truncate: later chunks go, this chunk keeps the frames up to the restored one
+    for (u32 i = ci + 1; i < rb->count; i++)
+        rb->frames -= rewind_chunk_at(rb, i)->nframes;
+    rb->count = ci + 1;
+    rb->frames -= c->nframes - nframes;
+    c->nframes = nframes;
+    c->nbytes = (u32)(p - (rb->arena + c->offset));
+    memcpy(&c->t_last, &rb->prev[0], sizeof(f64));
+    return true;
+}
+
+u64
+rewind_bytes(world *w)
+{
+    rewind_buffer *rb = w->rewind;
+    u64 bytes = 0;
+    for (u32 i = 0; rb && i < rb->count; i++)
+        bytes += rewind_chunk_at(rb, i)->nbytes;
+    return bytes;
+}
+
+f64
+rewind_oldest(world *w)
+{
+    rewind_buffer *rb = w->rewind;
+    return rb && rb->count ? rewind_chunk_at(rb, 0)->t_first : w->data->time;
+}
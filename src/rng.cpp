@@ -0,0 +1,117 @@
+#include "base.hpp"
+#include <math.h>
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3") turns a
+// 64-bit key and a 128-bit counter into four random u32 with no state in between, so any draw is a pure function of
+// where it sits. The key is the run's seed and the counter is (draw index, purpose, environment, episode): every
+// environment's episode gets its own sequence per purpose, whichever thread runs it and in whatever order, and drawing
+// sensor noise never shifts the initial conditions. Streams are small values; open one where it is needed.
+
+#define PHILOX_M0 0xd2511f53u
+#define PHILOX_M1 0xcd9e8d57u
+#define PHILOX_W0 0x9e3779b9u
+#define PHILOX_W1 0xbb67ae85u
+
+enum rng_purpose
+{
+    RNG_INITIAL_STATE,
+    RNG_DISTURBANCE,
+    RNG_SENSOR_NOISE,
+    RNG_BENCHMARK,
+};
+
+typedef struct rng_stream {
+    u32 key[2];
+    u32 counter[4]; // draw index, purpose, environment, episode
+    u32 block[4];
+    i32 used; // u32 of block already handed out
+    f64 spare; // second normal of the last Box-Muller pair
+    bool has_spare;
+} rng_stream;
+
+void philox4x32(const u32 key[2], const u32 counter[4], u32 out[4]);
+rng_stream rng_open(u64 seed, u32 env, u32 episode, i32 purpose);
+u64 rng_u64(rng_stream *s);
+f64 rng_uniform(rng_stream *s);
+f64 rng_symmetric(rng_stream *s);
+f64 rng_normal(rng_stream *s);
+
+void
+philox4x32(const u32 key[2], const u32 counter[4], u32 out[4])
+{
+    u32 k0 = key[0], k1 = key[1];
+    u32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    for (i32 round = 0; round < 10; round++)
+    {
+        u64 p0 = (u64)PHILOX_M0 * c0;
+        u64 p1 = (u64)PHILOX_M1 * c2;
+        c0 = (u32)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (u32)p1;
+        c2 = (u32)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (u32)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+rng_stream
+rng_open(u64 seed, u32 env, u32 episode, i32 purpose)
+{
+    rng_stream s = {};
+    s.key[0] = (u32)seed;
+    s.key[1] = (u32)(seed >> 32);
+    s.counter[1] = (u32)purpose;
+    s.counter[2] = env;
+    s.counter[3] = episode;
+    s.used = 4;
+    return s;
+}
+
+u64
+rng_u64(rng_stream *s)
+{
+    if (s->used == 4)
+    {
+        philox4x32(s->key, s->counter, s->block);
+        s->counter[0]++;
+        s->used = 0;
+    }
+    u64 v = s->block[s->used] | (u64)s->block[s->used + 1] << 32;
+    s->used += 2;
+    return v;
+}
+
+// [0, 1)
+f64
+rng_uniform(rng_stream *s)
+{
+    return (rng_u64(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// [-1, 1)
+f64
+rng_symmetric(rng_stream *s)
+{
+    return rng_uniform(s) * 2.0 - 1.0;
+}
+
+// standard normal, Box-Muller in pairs
+f64
+rng_normal(rng_stream *s)
+{
+    if (s->has_spare)
+    {
+        s->has_spare = false;
+        return s->spare;
+    }
+    f64 u1 = 1.0 - rng_uniform(s); // (0, 1], log stays finite
+    f64 u2 = rng_uniform(s);
+    f64 r = sqrt(-2.0 * log(u1));
+    s->spare = r * sin(2.0 * mjPI * u2);
+    s->has_spare = true;
+    return r * cos(2.0 * mjPI * u2);
+}
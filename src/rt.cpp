@@ -0,0 +1,112 @@
+#include "base.hpp"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+void init_rt(world *w);
+void rt_wait(world *w);
+void rt_report(world *w);
+i32 rt_jitter_bin(i64 jitter_ns);
+
+// bin 0 holds jitter below 1us, bin i holds [2^(i-1), 2^i) us, last bin is open ended
+i32
+rt_jitter_bin(i64 jitter_ns)
+{
+    i64 us = jitter_ns / 1000;
+    i32 bin = 0;
+    while (us > 0 && bin < RT_HIST_BINS - 1)
+    {
+        us >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+void
+init_rt(world *w)
+{
+    if (w->rt_period_ns <= 0) w->rt_period_ns = 10000000;
+    if (!w->rt_enabled) return;
+
+    // lock current and future pages so the loop never page faults
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        w->rt_locked = true;
+    else
+        fprintf(stderr, "rt: mlockall failed (%s), continuing with pageable memory\n", strerror(errno));
+
+#ifdef __linux__
+    i64 ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if (w->rt_cpu < 0 || w->rt_cpu >= CPU_SETSIZE || (ncpu > 0 && w->rt_cpu >= ncpu))
+    {
+        fprintf(stderr, "rt: cpu %d does not exist (%lld configured), continuing unpinned\n", w->rt_cpu, (long long)ncpu);
+    }
+    else
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->rt_cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == 0)
+            w->rt_pinned = true;
+        else
+            fprintf(stderr, "rt: pinning to cpu %d failed (%s), continuing unpinned\n", w->rt_cpu, strerror(errno));
+    }
+
+    sched_param param = {};
+    if (w->rt_priority <= 0) w->rt_priority = 80;
+    param.sched_priority = w->rt_priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == 0)
+        w->rt_fifo = true;
+    else
+        fprintf(stderr, "rt: SCHED_FIFO priority %d failed (%s), continuing with default scheduler\n", w->rt_priority, strerror(errno));
+#else
+    fprintf(stderr, "rt: cpu pinning and SCHED_FIFO are linux only, continuing without them\n");
+#endif
+
+    // vsync would block the loop inside glfwSwapBuffers, pace with the clock instead
+    glfwSwapInterval(0);
+    w->rt_next_ns = now_ns() + w->rt_period_ns;
+}
+
+void
+rt_wait(world *w)
+{
+    i64 now = now_ns();
+    if (now > w->rt_next_ns)
+    {
+        // loop body overran the deadline: count it and resync instead of bursting to catch up
+        w->rt_misses++;
+        w->rt_next_ns = now + w->rt_period_ns;
+    }
+
+    sleep_until_ns(w->rt_next_ns);
+    i64 jitter = now_ns() - w->rt_next_ns;
+    if (jitter < 0) jitter = 0;
+    if (jitter > w->rt_max_jitter_ns) w->rt_max_jitter_ns = jitter;
+    w->rt_jitter_hist[rt_jitter_bin(jitter)]++;
+    w->rt_periods++;
+    w->rt_next_ns += w->rt_period_ns;
+}
+
+void
+rt_report(world *w)
+{
+    if (!w->rt_enabled) return;
+    printf("rt: period %.3f ms, %llu periods, %llu deadline misses, max jitter %.1f us\n", //
+           w->rt_period_ns / 1e6, (unsigned long long)w->rt_periods, (unsigned long long)w->rt_misses, w->rt_max_jitter_ns / 1e3);
+    printf("rt: mlockall %s, pinned %s, SCHED_FIFO %s\n", //
+           w->rt_locked ? "yes" : "no", w->rt_pinned ? "yes" : "no", w->rt_fifo ? "yes" : "no");
+    for (i32 i = 0; i < RT_HIST_BINS; i++)
+    {
+        if (!w->rt_jitter_hist[i]) continue;
+        if (i == 0)
+            printf("rt:   jitter <      1 us : %llu\n", (unsigned long long)w->rt_jitter_hist[i]);
+        else if (i == RT_HIST_BINS - 1)
+            printf("rt:   jitter >= %6d us : %llu\n", 1 << (i - 1), (unsigned long long)w->rt_jitter_hist[i]);
+        else
+            printf("rt:   jitter <  %6d us : %llu\n", 1 << i, (unsigned long long)w->rt_jitter_hist[i]);
+    }
+}
@@ -0,0 +1,172 @@
+#include "base.hpp"
+
+void step_sim(world *w);
+void pace_frame(world *w);
+void update_rate_stats(world *w);
+void after_step(world *w);
+i32 choose_substeps(world *w);
+
+// advance physics by one render frame worth of substeps, running the controller at its own rate in between (zero-order
+// hold: ctrl keeps its last value on the steps where the controller does not run)
+void
+step_sim(world *w)
+{
+    i32 nsteps;
+    if (w->adaptive_substeps)
+    {
+        nsteps = choose_substeps(w);
+    }
+    else
+    {
+        w->model->opt.timestep = 1.0 / w->physics_hz;
+        w->steps_owed += w->physics_hz / w->render_hz;
+        nsteps = (i32)w->steps_owed;
+        w->steps_owed -= nsteps;
+        w->falling_behind = false;
+    }
+    f64 dt = w->model->opt.timestep;
+    f64 control_period = 1.0 / w->control_hz;
+    if (control_period < dt) control_period = dt;
+
+    set_control_callback(w, w->control_in_mujoco);
+
+    i64 start = now_ns();
+    for (i32 i = 0; i < nsteps; i++)
+    {
+        i64 step_start = now_ns();
+        if (w->control_in_mujoco)
+        {
+            // control runs inside mj_step through mjcb_control; the fleet keeps its batched law, once per substep
+            alloc_guard_begin("control");
+            fleet_control(w);
+            alloc_guard_end();
+            alloc_guard_begin("mj_step");
+            mj_step(w->model, w->data);
+            fleet_step(w);
+            alloc_guard_end();
+            alloc_guard_begin("after_step");
+            after_step(w);
+            metrics_step(w, now_ns() - step_start);
+            alloc_guard_end();
+            w->control_updates++;
+            continue;
+        }
+
+        // sim time went backwards (reset): resync the control clock
+        if (w->next_control_time - w->data->time > control_period) w->next_control_time = w->data->time;
+        if (w->data->time >= w->next_control_time - 0.5 * dt)
+        {
+            alloc_guard_begin("control");
+            if (w->ext)
+                ext_control(w);
+            else
+                control(w);
+            fleet_control(w);
+            alloc_guard_end();
+            w->control_updates++;
+            w->next_control_time += control_period;
+            if (w->next_control_time <= w->data->time) w->next_control_time = w->data->time + control_period;
+        }
+
+        alloc_guard_begin("mj_step");
+        mj_step(w->model, w->data);
+        fleet_step(w);
+        alloc_guard_end();
+        alloc_guard_begin("after_step");
+        after_step(w);
+        metrics_step(w, now_ns() - step_start);
+        alloc_guard_end();
+    }
+    if (w->control_in_mujoco)
+    {
+        read_state_from_sim(w, w->x, w->y);
+        w->ux = w->data->ctrl[0];
+        w->uy = w->data->ctrl[1];
+    }
+    if (nsteps > 0)
+    {
+        // per-substep cost including control, smoothed so the substep count does not chatter
+        f64 cost = (f64)(now_ns() - start) / nsteps;
+        w->step_cost_ns = w->step_cost_ns > 0 ? 0.9 * w->step_cost_ns + 0.1 * cost : cost;
+    }
+    w->render_frames++;
+    update_rate_stats(w);
+}
+
+// per-step consumers of the new state: recording, rewind history and plots
+void
+after_step(world *w)
+{
+    telemetry_push(w);
+    stream_push(w);
+    rewind_push(w);
+    plot_push(w);
+    w->physics_steps++;
+}
+
+// Choose how many substeps fit in physics_budget of the frame and spread one frame of sim time (target_rtf / render_hz)
+// over them. With headroom the timestep shrinks towards min_timestep; when loaded it grows up to max_timestep, and past
+// that the sim slows down below target_rtf and falling_behind is raised.
+i32
+choose_substeps(world *w)
+{
+    f64 frame_sim = w->target_rtf / w->render_hz;
+    f64 budget_ns = w->physics_budget * 1e9 / w->render_hz;
+    f64 cost = w->step_cost_ns > 0 ? w->step_cost_ns : 1e4;
+
+    i32 affordable = (i32)(budget_ns / cost);
+    i32 most = (i32)ceil(frame_sim / w->min_timestep);
+    i32 fewest = (i32)ceil(frame_sim / w->max_timestep);
+    i32 nsteps = mjMAX(1, mjMIN(affordable, most));
+
+    f64 dt = frame_sim / nsteps;
+    w->falling_behind = nsteps < fewest;
+    if (w->falling_behind) dt = w->max_timestep;
+    w->model->opt.timestep = dt;
+    w->physics_hz = (f32)(1.0 / dt);
+    return nsteps;
+}
+
+// measured rates over the last wall-clock second, for the timing panel
+void
+update_rate_stats(world *w)
+{
+    i64 now = now_ns();
+    if (!w->rate_window_start_ns)
+    {
+        w->rate_window_start_ns = now;
+        w->rate_window_sim_time = w->data->time;
+        return;
+    }
+    i64 elapsed = now - w->rate_window_start_ns;
+    if (elapsed < 1000000000) return;
+
+    f64 seconds = elapsed / 1e9;
+    w->measured_physics_hz = (w->physics_steps - w->rate_window_physics_steps) / seconds;
+    w->measured_control_hz = (w->control_updates - w->rate_window_control_updates) / seconds;
+    w->measured_render_hz = (w->render_frames - w->rate_window_render_frames) / seconds;
+    w->measured_rtf = (w->data->time - w->rate_window_sim_time) / seconds;
+    w->rate_window_start_ns = now;
+    w->rate_window_physics_steps = w->physics_steps;
+    w->rate_window_control_updates = w->control_updates;
+    w->rate_window_render_frames = w->render_frames;
+    w->rate_window_sim_time = w->data->time;
+}
+
+// sleep until the next render frame is due
+void
+pace_frame(world *w)
+{
+    i64 period = (i64)(1e9 / w->render_hz);
+    if (w->rt_enabled)
+    {
+        w->rt_period_ns = period;
+        rt_wait(w);
+        return;
+    }
+
+    i64 now = now_ns();
+    if (now > w->frame_next_ns + period) w->frame_next_ns = now; // fell behind: resync
+    w->frame_next_ns += period;
+    sleep_until_ns(w->frame_next_ns);
+}
@@ -0,0 +1,242 @@
+#include "base.hpp"
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// Live telemetry stream for local dashboards (--stream PATH). The sim thread drops one sample per physics step into a
+// lock-free ring (the one the recorder uses); a publisher thread accepts subscribers on a Unix SOCK_SEQPACKET socket,
+// batches samples into frames of up to STREAM_FRAME_SAMPLES or STREAM_FLUSH_MS worth and sends every frame to every
+// subscriber without blocking. A subscriber whose socket buffer is full loses that frame, counted on its side through
+// the dropped_frames field of later frames, and a full ring loses samples on the sim side; nothing ever waits.
+//
+// frame: stream_frame_header, then nsamples stream_sample, all little-endian f64/u64 as in memory.
+
+#define STREAM_MAGIC "MPSF"
+#define STREAM_VERSION 1
+#define STREAM_RING_SIZE (1 << 14)
+#define STREAM_FRAME_SAMPLES 64
+#define STREAM_FLUSH_MS 10
+#define STREAM_MAX_SUBSCRIBERS 32
+
+typedef struct stream_sample {
+    u64 step;
+    f64 time;
+    f64 x[nstate];
+    f64 y[nstate];
+    f64 ux;
+    f64 uy;
+} stream_sample;
+
+typedef struct stream_frame_header {
+    char magic[4];
+    u16 version;
+    u16 sample_size;
+    u32 nsamples;
+    u32 subscriber_dropped_frames; // frames this subscriber has missed so far
+    u64 dropped_samples;           // samples the sim side could not queue so far
+} stream_frame_header;
+
+typedef struct stream_subscriber {
+    i32 fd; // -1: free slot
+    u32 dropped_frames;
+} stream_subscriber;
+
+typedef struct stream_publisher {
+    spsc_ring<stream_sample, STREAM_RING_SIZE> ring;
+    char path[108];
+    i32 listen_fd;
+    std::thread worker;
+    std::atomic<bool> running;
+    u64 steps; // producer only
+
+    std::atomic<u64> dropped_samples;
+    std::atomic<u64> frames_sent;
+    std::atomic<u64> frames_dropped;
+    std::atomic<i32> nsubscribers;
+
+    // publisher thread only
+    stream_subscriber subscribers[STREAM_MAX_SUBSCRIBERS];
+    struct {
+        stream_frame_header header;
+        stream_sample samples[STREAM_FRAME_SAMPLES];
+    } frame;
+} stream_publisher;
+
+void init_stream(world *w);
+void destroy_stream(world *w);
+void stream_push(world *w);
+
+void
+stream_accept(stream_publisher *sp)
+{
+    for (;;)
+    {
+        i32 fd = accept(sp->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        stream_subscriber *slot = NULL;
+        for (stream_subscriber &s : sp->subscribers)
+            if (s.fd < 0 && !slot) slot = &s;
+        if (!slot)
+        {
+            close(fd);
+            continue;
+        }
+        slot->fd = fd;
+        slot->dropped_frames = 0;
+        sp->nsubscribers.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void
+stream_close_subscriber(stream_publisher *sp, stream_subscriber *s)
+{
+    close(s->fd);
+    s->fd = -1;
+    sp->nsubscribers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// send the batched frame to everyone; a full socket buffer drops it for that subscriber only
+void
+stream_send(stream_publisher *sp, u32 nsamples)
+{
+    stream_frame_header *h = &sp->frame.header;
+    memcpy(h->magic, STREAM_MAGIC, 4);
+    h->version = STREAM_VERSION;
+    h->sample_size = sizeof(stream_sample);
+    h->nsamples = nsamples;
+    h->dropped_samples = sp->dropped_samples.load(std::memory_order_relaxed);
+    size_t size = sizeof(stream_frame_header) + nsamples * sizeof(stream_sample);
+#ifdef MSG_NOSIGNAL
+    const i32 flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+    const i32 flags = MSG_DONTWAIT;
+#endif
+    for (stream_subscriber &s : sp->subscribers)
+    {
+        if (s.fd < 0) continue;
+        h->subscriber_dropped_frames = s.dropped_frames;
+        if (send(s.fd, &sp->frame, size, flags) == (ssize_t)size)
+        {
+            sp->frames_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        {
+            s.dropped_frames++;
+            sp->frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            stream_close_subscriber(sp, &s);
+        }
+    }
+}
+
+void
+stream_publish(stream_publisher *sp)
+{
+    u32 batched = 0;
+    i64 first_ns = 0;
+    while (sp->running.load(std::memory_order_relaxed))
+    {
+        // wake for new subscribers, or often enough to honour the flush interval
+        pollfd p = { sp->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, batched ? 1 : STREAM_FLUSH_MS) > 0) stream_accept(sp);
+
+        while (stream_sample *s = sp->ring.peek())
+        {
+            if (!batched) first_ns = now_ns();
+            sp->frame.samples[batched++] = *s;
+            sp->ring.pop();
+            if (batched == STREAM_FRAME_SAMPLES)
+            {
+                stream_send(sp, batched);
+                batched = 0;
+            }
+        }
+        if (batched && now_ns() - first_ns >= (i64)STREAM_FLUSH_MS * 1000000)
+        {
+            stream_send(sp, batched);
+            batched = 0;
+        }
+    }
+}
+
+void
+init_stream(world *w)
+{
+    if (!w->stream_path[0]) return;
+    stream_publisher *sp = new stream_publisher();
+    snprintf(sp->path, sizeof(sp->path), "%s", w->stream_path);
+    for (stream_subscriber &s : sp->subscribers)
+        s.fd = -1;
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sp->path);
+    sp->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    unlink(sp->path); // left over from a crashed run
+    if (sp->listen_fd < 0 || bind(sp->listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(sp->listen_fd, 8) != 0)
+    {
+        fprintf(stderr, "stream: cannot listen on %s (%s)\n", sp->path, strerror(errno));
+        if (sp->listen_fd >= 0) close(sp->listen_fd);
+        delete sp;
+        return;
+    }
+    fcntl(sp->listen_fd, F_SETFL, fcntl(sp->listen_fd, F_GETFL) | O_NONBLOCK);
+    sp->running.store(true);
+    sp->worker = std::thread(stream_publish, sp);
+    w->stream = sp;
+}
+
+void
+destroy_stream(world *w)
+{
+    stream_publisher *sp = w->stream;
+    if (!sp) return;
+    sp->running.store(false);
+    sp->worker.join();
+    for (stream_subscriber &s : sp->subscribers)
+        if (s.fd >= 0) close(s.fd);
+    close(sp->listen_fd);
+    unlink(sp->path);
+    delete sp;
+    w->stream = NULL;
+}
+
+// sim thread, after every physics step
+void
+stream_push(world *w)
+{
+    stream_publisher *sp = w->stream;
+    if (!sp) return;
+    u64 step = sp->steps++;
+    // nobody to send to: keep the ring empty rather than replaying stale samples to the next subscriber
+    if (!sp->nsubscribers.load(std::memory_order_relaxed)) return;
+    stream_sample *s = sp->ring.reserve();
+    if (!s)
+    {
+        sp->dropped_samples.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Eigen::Matrix<f64, nstate, 1> x;
+    Eigen::Matrix<f64, nstate, 1> y;
+    read_state_from_sim(w, x, y);
+    s->step = step;
+    s->time = w->data->time;
+    for (i32 i = 0; i < nstate; i++)
+    {
+        s->x[i] = x(i);
+        s->y[i] = y(i);
+    }
+    s->ux = w->data->ctrl[0];
+    s->uy = w->data->ctrl[1];
+    sp->ring.commit();
+}
@@ -0,0 +1,750 @@
+#include "base.hpp"
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Per-step telemetry recorder. The sim thread fills preallocated slots of a lock-free single-producer single-consumer
+// ring; a writer thread drains it into fixed-size column-major blocks appended to a memory-mapped file.
+//
+// file layout: telemetry_header, then blocks of { telemetry_block, col_min[ncol], col_max[ncol], data }. A zeroed block
+// header marks the end of a file that was not closed cleanly. With TELEMETRY_CODEC_RAW data is ncol columns of nsamples
+// f64; with TELEMETRY_CODEC_PACKED it is a u32 table of (codec << 28 | bytes) per column, padded to 8 bytes, followed
+// by the column streams of codec.cpp. Readers skip blocks by t_min/t_max and the column ranges without decoding them.
+//
+// Every TELEMETRY_KEYFRAME_INTERVAL steps an mjSTATE_INTEGRATION snapshot goes to <path>.keys: a
+// telemetry_keys_header followed by fixed-size { step, time, state[state_size] } records, so keyframe i sits at a known
+// offset and seeking needs no scan. The integration state includes qfrc_applied, which the W/A/S/D pushes set and
+// nothing clears, so re-simulating from a keyframe sees the same forces the recorded run did.
+
+#define TELEMETRY_MAGIC "MPTELEM"
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_CODEC_RAW 0
+#define TELEMETRY_CODEC_PACKED 1
+#define TELEMETRY_MAX_DOF 8
+#define TELEMETRY_RING_SIZE (1 << 16)
+#define TELEMETRY_BLOCK_SAMPLES 4096
+#define TELEMETRY_MAP_WINDOW (64 << 20)
+#define TELEMETRY_FIXED_COLS (1 + 2 * nstate + 2) // time, x, y, ux, uy
+#define TELEMETRY_KEYS_MAGIC "MPKEYS"
+#define TELEMETRY_KEYFRAME_INTERVAL 256
+#define TELEMETRY_KEYFRAME_RING 256
+#define TELEMETRY_MAX_STATE 128
+#define TELEMETRY_KEYFRAME_SIG mjSTATE_INTEGRATION
+
+template <typename T, u32 N>
+struct spsc_ring {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    alignas(64) std::atomic<u64> head; // next slot the producer fills
+    alignas(64) std::atomic<u64> tail; // next slot the consumer reads
+    alignas(64) T slots[N];
+
+    // producer: slot to fill in place, NULL when full
+    T *
+    reserve()
+    {
+        u64 h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) return NULL;
+        return &slots[h & (N - 1)];
+    }
+
+    void
+    commit()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer: oldest filled slot, NULL when empty
+    T *
+    peek()
+    {
+        u64 t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return NULL;
+        return &slots[t & (N - 1)];
+    }
+
+    void
+    pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+typedef struct telemetry_sample {
+    f64 time;
+    f64 x[nstate];
+    f64 y[nstate];
+    f64 ux;
+    f64 uy;
+    f64 qpos[TELEMETRY_MAX_DOF];
+    f64 qvel[TELEMETRY_MAX_DOF];
+} telemetry_sample;
+
+typedef struct telemetry_header {
+    char magic[8];
+    u32 version;
+    u32 codec;
+    u64 model_hash;
+    f64 timestep;
+    f64 Q[nstate * nstate];
+    f64 K[nact * nstate];
+    f64 R;
+    u32 nq;
+    u32 nv;
+    u32 ncol;
+    u32 block_samples;
+    u64 nblocks;
+    u64 nsamples;
+    f64 quantum; // absolute resolution of packed state columns (not time or ux/uy), 0 when lossless
+} telemetry_header;
+
+typedef struct telemetry_block {
+    u32 nsamples;
+    u32 payload_bytes;
+    f64 t_min;
+    f64 t_max;
+} telemetry_block;
+
+typedef struct telemetry_keyframe {
+    u64 step;
+    f64 time;
+    f64 state[TELEMETRY_MAX_STATE];
+} telemetry_keyframe;
+
+typedef struct telemetry_keys_header {
+    char magic[8];
+    u32 version;
+    u32 sig;
+    u32 state_size;
+    u32 interval;
+    u64 model_hash;
+} telemetry_keys_header;
+
+typedef struct telemetry_recorder {
+    spsc_ring<telemetry_sample, TELEMETRY_RING_SIZE> ring;
+    spsc_ring<telemetry_keyframe, TELEMETRY_KEYFRAME_RING> keys;
+    u64 steps; // producer only
+    std::thread writer;
+    std::atomic<bool> running;
+    std::atomic<u64> written;
+    std::atomic<u64> dropped;
+    std::atomic<u64> bytes;
+    std::atomic<bool> failed; // a block could not be written; the file ends with the last complete one
+
+    // writer thread only
+    telemetry_header header;
+    telemetry_keys_header keys_header;
+    i32 keys_fd;
+    i32 fd;
+    u8 *map;
+    u64 map_offset;
+    u64 map_size;
+    u64 file_size;
+    u64 offset;
+    f64 *columns;
+    f64 *minmax;
+    u8 *packed;
+    u8 *scratch;
+    u32 nfill;
+    f64 t_min;
+    f64 t_max;
+} telemetry_recorder;
+
+bool telemetry_start(world *w, const char *path);
+void telemetry_stop(world *w);
+void telemetry_push(world *w);
+i32 telemetry_sample_values(const telemetry_sample *s, i32 nq, i32 nv, f64 *out);
+
+// flatten a sample in column order: time, x[4], y[4], ux, uy, qpos[nq], qvel[nv]
+i32
+telemetry_sample_values(const telemetry_sample *s, i32 nq, i32 nv, f64 *out)
+{
+    i32 n = 0;
+    out[n++] = s->time;
+    for (i32 i = 0; i < nstate; i++)
+        out[n++] = s->x[i];
+    for (i32 i = 0; i < nstate; i++)
+        out[n++] = s->y[i];
+    out[n++] = s->ux;
+    out[n++] = s->uy;
+    for (i32 i = 0; i < nq; i++)
+        out[n++] = s->qpos[i];
+    for (i32 i = 0; i < nv; i++)
+        out[n++] = s->qvel[i];
+    return n;
+}
+
+bool
+telemetry_append(telemetry_recorder *rec, const void *data, u64 size)
+{
+    if (rec->offset + size > rec->map_offset + rec->map_size)
+    {
+        if (rec->map) munmap(rec->map, rec->map_size);
+        u64 page = (u64)sysconf(_SC_PAGESIZE);
+        rec->map_offset = rec->offset & ~(page - 1);
+        rec->map_size = TELEMETRY_MAP_WINDOW;
+        while (rec->offset + size > rec->map_offset + rec->map_size)
+            rec->map_size *= 2;
+        if (rec->file_size < rec->map_offset + rec->map_size)
+        {
+            rec->file_size = rec->map_offset + rec->map_size;
+            if (ftruncate(rec->fd, rec->file_size) != 0) return false;
+        }
+        rec->map = (u8 *)mmap(NULL, rec->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, rec->map_offset);
+        if (rec->map == MAP_FAILED)
+        {
+            rec->map = NULL;
+            rec->map_size = 0;
+            return false;
+        }
+    }
+    memcpy(rec->map + (rec->offset - rec->map_offset), data, size);
+    rec->offset += size;
+    rec->bytes.store(rec->offset, std::memory_order_relaxed);
+    return true;
+}
+
+void
+telemetry_flush_block(telemetry_recorder *rec)
+{
+    if (!rec->nfill) return;
+    u32 ncol = rec->header.ncol;
+    u32 bs = rec->header.block_samples;
+    for (u32 c = 0; c < ncol; c++)
+    {
+        const f64 *col = rec->columns + (u64)c * bs;
+        f64 lo = col[0];
+        f64 hi = col[0];
+        for (u32 i = 1; i < rec->nfill; i++)
+        {
+            lo = mjMIN(lo, col[i]);
+            hi = mjMAX(hi, col[i]);
+        }
+        rec->minmax[c] = lo;
+        rec->minmax[ncol + c] = hi;
+    }
+
+    u64 data_bytes = (u64)ncol * rec->nfill * sizeof(f64);
+    if (rec->header.codec == TELEMETRY_CODEC_PACKED)
+    {
+        u32 *table = (u32 *)rec->packed;
+        u8 *p = rec->packed + ((ncol * sizeof(u32) + 7) & ~7ull);
+        for (u32 c = 0; c < ncol; c++)
+        {
+            u64 bytes;
+            // time and the controls stay lossless even when quantizing: replay_resume re-simulates from them
+            bool lossless = c == 0 || c == 1 + 2 * nstate || c == 2 + 2 * nstate;
+            f64 quantum = lossless ? 0.0 : rec->header.quantum;
+            i32 codec = encode_column(rec->columns + (u64)c * bs, rec->nfill, quantum, p, rec->scratch, &bytes);
+            table[c] = ((u32)codec << 28) | (u32)bytes;
+            p += bytes;
+        }
+        data_bytes = p - rec->packed;
+    }
+
+    // a block that cannot be written whole is rolled back and ends the recording, so the header only counts complete
+    // blocks and the file is trimmed right after the last one
+    u64 start = rec->offset;
+    telemetry_block block = {};
+    block.nsamples = rec->nfill;
+    block.payload_bytes = (u32)(2 * ncol * sizeof(f64) + data_bytes);
+    block.t_min = rec->t_min;
+    block.t_max = rec->t_max;
+    bool ok = telemetry_append(rec, &block, sizeof(block));
+    ok = ok && telemetry_append(rec, rec->minmax, 2 * ncol * sizeof(f64));
+    if (rec->header.codec == TELEMETRY_CODEC_PACKED)
+        ok = ok && telemetry_append(rec, rec->packed, data_bytes);
+    for (u32 c = 0; rec->header.codec == TELEMETRY_CODEC_RAW && ok && c < ncol; c++)
+        ok = telemetry_append(rec, rec->columns + (u64)c * bs, rec->nfill * sizeof(f64));
+    if (!ok)
+    {
+        fprintf(stderr, "telemetry: failed to append block: %s, recording stopped\n", strerror(errno));
+        rec->offset = start;
+        rec->bytes.store(start, std::memory_order_relaxed);
+        rec->written.fetch_sub(rec->nfill, std::memory_order_relaxed);
+        rec->dropped.fetch_add(rec->nfill, std::memory_order_relaxed);
+        rec->failed.store(true, std::memory_order_relaxed);
+        rec->nfill = 0;
+        return;
+    }
+
+    rec->header.nblocks++;
+    rec->header.nsamples += rec->nfill;
+    rec->nfill = 0;
+}
+
+void
+telemetry_writer(telemetry_recorder *rec)
+{
+    f64 values[TELEMETRY_FIXED_COLS + 2 * TELEMETRY_MAX_DOF];
+    u32 bs = rec->header.block_samples;
+    for (;;)
+    {
+        bool failed = rec->failed.load(std::memory_order_relaxed);
+        telemetry_keyframe *kf = rec->keys.peek();
+        if (kf && failed)
+        {
+            rec->keys.pop();
+        }
+        else if (kf)
+        {
+            size_t size = sizeof(u64) + sizeof(f64) * (1 + rec->keys_header.state_size);
+            if (write(rec->keys_fd, kf, size) != (ssize_t)size) fprintf(stderr, "telemetry: failed to write keyframe: %s\n", strerror(errno));
+            rec->keys.pop();
+        }
+
+        telemetry_sample *s = rec->ring.peek();
+        if (!s)
+        {
+            if (kf) continue;
+            if (!rec->running.load(std::memory_order_acquire)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        if (failed)
+        {
+            // drain so the sim side never sees a full ring, but keep nothing
+            rec->ring.pop();
+            rec->dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        i32 ncol = telemetry_sample_values(s, rec->header.nq, rec->header.nv, values);
+        rec->ring.pop();
+
+        for (i32 c = 0; c < ncol; c++)
+            rec->columns[(u64)c * bs + rec->nfill] = values[c];
+        if (!rec->nfill || values[0] < rec->t_min) rec->t_min = values[0];
+        if (!rec->nfill || values[0] > rec->t_max) rec->t_max = values[0];
+        rec->nfill++;
+        rec->written.fetch_add(1, std::memory_order_relaxed);
+        if (rec->nfill == bs) telemetry_flush_block(rec);
+    }
+    telemetry_flush_block(rec);
+
+    // final counts into the header, trim the file to what was written
+    if (pwrite(rec->fd, &rec->header, sizeof(rec->header), 0) != sizeof(rec->header))
+        fprintf(stderr, "telemetry: failed to update header: %s\n", strerror(errno));
+    if (rec->map) munmap(rec->map, rec->map_size);
+    if (ftruncate(rec->fd, rec->offset) != 0) fprintf(stderr, "telemetry: failed to trim file: %s\n", strerror(errno));
+    close(rec->fd);
+    close(rec->keys_fd);
+}
+
+bool
+telemetry_start(world *w, const char *path)
+{
+    if (w->recorder) return true;
+    if (w->model->nq > TELEMETRY_MAX_DOF || w->model->nv > TELEMETRY_MAX_DOF)
+    {
+        fprintf(stderr, "telemetry: model has more than %d dofs, not recording\n", TELEMETRY_MAX_DOF);
+        return false;
+    }
+    i32 state_size = mj_stateSize(w->model, TELEMETRY_KEYFRAME_SIG);
+    if (state_size > TELEMETRY_MAX_STATE)
+    {
+        fprintf(stderr, "telemetry: integration state has more than %d values, not recording\n", TELEMETRY_MAX_STATE);
+        return false;
+    }
+    char keys_path[300];
+    snprintf(keys_path, sizeof(keys_path), "%s.keys", path);
+    i32 fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    i32 keys_fd = open(keys_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || keys_fd < 0)
+    {
+        fprintf(stderr, "telemetry: cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        if (keys_fd >= 0) close(keys_fd);
+        return false;
+    }
+
+    telemetry_recorder *rec = new telemetry_recorder();
+    rec->fd = fd;
+    rec->keys_fd = keys_fd;
+    telemetry_keys_header *kh = &rec->keys_header;
+    memcpy(kh->magic, TELEMETRY_KEYS_MAGIC, sizeof(TELEMETRY_KEYS_MAGIC));
+    kh->version = TELEMETRY_VERSION;
+    kh->sig = TELEMETRY_KEYFRAME_SIG;
+    kh->state_size = state_size;
+    kh->interval = TELEMETRY_KEYFRAME_INTERVAL;
+    kh->model_hash = w->model_hash;
+    telemetry_header *h = &rec->header;
+    memcpy(h->magic, TELEMETRY_MAGIC, sizeof(h->magic));
+    h->version = TELEMETRY_VERSION;
+    h->codec = w->telemetry_compress ? TELEMETRY_CODEC_PACKED : TELEMETRY_CODEC_RAW;
+    h->quantum = w->telemetry_compress ? w->telemetry_quantum : 0.0;
+    h->model_hash = w->model_hash;
+    h->timestep = w->model->opt.timestep;
+    for (i32 i = 0; i < nstate; i++)
+        for (i32 j = 0; j < nstate; j++)
+            h->Q[i * nstate + j] = w->Q(i, j);
+    for (i32 i = 0; i < nstate; i++)
+        h->K[i] = w->K(0, i);
+    h->R = w->R;
+    h->nq = w->model->nq;
+    h->nv = w->model->nv;
+    h->ncol = TELEMETRY_FIXED_COLS + h->nq + h->nv;
+    h->block_samples = TELEMETRY_BLOCK_SAMPLES;
+    if (pwrite(fd, h, sizeof(*h), 0) != sizeof(*h) || write(keys_fd, kh, sizeof(*kh)) != sizeof(*kh))
+    {
+        fprintf(stderr, "telemetry: cannot write %s: %s\n", path, strerror(errno));
+        close(fd);
+        close(keys_fd);
+        delete rec;
+        return false;
+    }
+    rec->offset = sizeof(*h);
+    rec->columns = new f64[(u64)h->ncol * h->block_samples];
+    rec->minmax = new f64[2 * h->ncol];
+    if (h->codec == TELEMETRY_CODEC_PACKED)
+    {
+        rec->packed = new u8[h->ncol * sizeof(u32) + 8 + h->ncol * codec_bound(h->block_samples)];
+        rec->scratch = new u8[codec_bound(h->block_samples)];
+    }
+
+    rec->running.store(true);
+    rec->writer = std::thread(telemetry_writer, rec);
+    w->recorder = rec;
+    return true;
+}
+
+void
+telemetry_stop(world *w)
+{
+    telemetry_recorder *rec = w->recorder;
+    if (!rec) return;
+    w->recorder = NULL;
+    rec->running.store(false, std::memory_order_release);
+    rec->writer.join();
+    delete[] rec->columns;
+    delete[] rec->minmax;
+    delete[] rec->packed;
+    delete[] rec->scratch;
+    delete rec;
+}
+
+// hot path: called after every physics step, fills a ring slot in place and never allocates. ctrl is the value that
+// was applied over the step that ended at time.
+void
+telemetry_push(world *w)
+{
+    telemetry_recorder *rec = w->recorder;
+    if (!rec) return;
+    telemetry_sample *s = rec->ring.reserve();
+    if (!s)
+    {
+        rec->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Eigen::Matrix<f64, nstate, 1> x;
+    Eigen::Matrix<f64, nstate, 1> y;
+    read_state_from_sim(w, x, y);
+    s->time = w->data->time;
+    for (i32 i = 0; i < nstate; i++)
+    {
+        s->x[i] = x(i);
+        s->y[i] = y(i);
+    }
+    s->ux = w->data->ctrl[0];
+    s->uy = w->data->ctrl[1];
+    mju_copy(s->qpos, w->data->qpos, w->model->nq);
+    mju_copy(s->qvel, w->data->qvel, w->model->nv);
+    rec->ring.commit();
+
+    if (rec->steps++ % TELEMETRY_KEYFRAME_INTERVAL == 0)
+    {
+        telemetry_keyframe *kf = rec->keys.reserve();
+        if (!kf) return;
+        kf->step = rec->steps - 1;
+        kf->time = w->data->time;
+        mj_getState(w->model, w->data, kf->state, TELEMETRY_KEYFRAME_SIG);
+        rec->keys.commit();
+    }
+}
+
+typedef struct telemetry_block_ref {
+    u64 offset; // payload offset in the file: col_min, col_max, then data
+    u64 first;  // index of the first sample in the block
+    u32 nsamples;
+    f64 t_min;
+    f64 t_max;
+} telemetry_block_ref;
+
+typedef struct telemetry_reader {
+    telemetry_header header;
+    i32 fd;
+    const u8 *map;
+    u64 size;
+    std::vector<telemetry_block_ref> blocks;
+    u64 nsamples;
+
+    // decoded columns of one packed block
+    std::vector<f64> cache;
+    i64 cached_block;
+    u64 cached_cols;
+
+    telemetry_keys_header keys_header;
+    i32 keys_fd;
+    const u8 *keys_map;
+    u64 keys_size;
+    u64 keys_stride;
+    u64 nkeys;
+} telemetry_reader;
+
+bool telemetry_reader_open(telemetry_reader *r, const char *path);
+void telemetry_reader_close(telemetry_reader *r);
+const f64 *telemetry_reader_columns(telemetry_reader *r, u64 block);
+const f64 *telemetry_reader_column(telemetry_reader *r, u64 block, u32 col);
+u64 telemetry_reader_first_block(telemetry_reader *r, f64 time);
+f64 telemetry_reader_col_min(telemetry_reader *r, u64 block, u32 col);
+f64 telemetry_reader_col_max(telemetry_reader *r, u64 block, u32 col);
+void telemetry_reader_sample(telemetry_reader *r, u64 index, f64 *values);
+u64 telemetry_reader_find(telemetry_reader *r, f64 time);
+const telemetry_keyframe *telemetry_reader_keyframe(telemetry_reader *r, f64 time);
+
+const u8 *
+map_file(const char *path, i32 *fd_out, u64 *size_out)
+{
+    i32 fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+    *fd_out = fd;
+    *size_out = size;
+    return (const u8 *)map;
+}
+
+bool
+telemetry_reader_open(telemetry_reader *r, const char *path)
+{
+    r->map = map_file(path, &r->fd, &r->size);
+    if (!r->map) return false;
+    if (r->size < sizeof(telemetry_header) || memcmp(r->map, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC)))
+    {
+        telemetry_reader_close(r);
+        return false;
+    }
+    memcpy(&r->header, r->map, sizeof(r->header));
+    if (r->header.version != TELEMETRY_VERSION)
+    {
+        fprintf(stderr, "telemetry: %s is format version %u, expected %u\n", path, r->header.version, TELEMETRY_VERSION);
+        telemetry_reader_close(r);
+        return false;
+    }
+    r->cache.resize((u64)r->header.ncol * r->header.block_samples);
+    r->cached_block = -1;
+    r->cached_cols = 0;
+
+    // index the blocks; the header counts are only final after a clean close, so walk until a zeroed header
+    r->blocks.clear();
+    r->nsamples = 0;
+    u64 offset = sizeof(telemetry_header);
+    while (offset + sizeof(telemetry_block) <= r->size)
+    {
+        telemetry_block block;
+        memcpy(&block, r->map + offset, sizeof(block));
+        if (!block.nsamples) break;
+        offset += sizeof(block);
+        if (offset + block.payload_bytes > r->size) break;
+        telemetry_block_ref ref = { offset, r->nsamples, block.nsamples, block.t_min, block.t_max };
+        r->blocks.push_back(ref);
+        r->nsamples += block.nsamples;
+        offset += block.payload_bytes;
+    }
+
+    char keys_path[300];
+    snprintf(keys_path, sizeof(keys_path), "%s.keys", path);
+    r->keys_map = map_file(keys_path, &r->keys_fd, &r->keys_size);
+    r->nkeys = 0;
+    if (r->keys_map && r->keys_size >= sizeof(telemetry_keys_header))
+    {
+        memcpy(&r->keys_header, r->keys_map, sizeof(r->keys_header));
+        r->keys_stride = sizeof(u64) + sizeof(f64) * (1 + r->keys_header.state_size);
+        r->nkeys = (r->keys_size - sizeof(telemetry_keys_header)) / r->keys_stride;
+    }
+    return true;
+}
+
+void
+telemetry_reader_close(telemetry_reader *r)
+{
+    if (r->map) munmap((void *)r->map, r->size);
+    if (r->keys_map) munmap((void *)r->keys_map, r->keys_size);
+    if (r->map) close(r->fd);
+    if (r->keys_map) close(r->keys_fd);
+    r->map = NULL;
+    r->keys_map = NULL;
+    r->blocks.clear();
+}
+
+// one column of a block, decoded into the reader's cache for packed files
+const f64 *
+telemetry_reader_column(telemetry_reader *r, u64 block, u32 col)
+{
+    telemetry_block_ref *ref = &r->blocks[block];
+    u32 ncol = r->header.ncol;
+    const u8 *data = r->map + ref->offset + 2 * ncol * sizeof(f64);
+    if (r->header.codec == TELEMETRY_CODEC_RAW) return (const f64 *)data + (u64)col * ref->nsamples;
+
+    if (r->cached_block != (i64)block)
+    {
+        r->cached_block = block;
+        r->cached_cols = 0;
+    }
+    f64 *out = r->cache.data() + (u64)col * ref->nsamples;
+    if (!(r->cached_cols & (1ull << col)))
+    {
+        const u32 *table = (const u32 *)data;
+        const u8 *p = data + ((ncol * sizeof(u32) + 7) & ~7ull);
+        for (u32 c = 0; c < col; c++)
+            p += table[c] & 0x0fffffff;
+        decode_column(table[col] >> 28, p, ref->nsamples, col ? r->header.quantum : 0.0, out);
+        r->cached_cols |= 1ull << col;
+    }
+    return out;
+}
+
+// column-major values of a block: column c starts at c * blocks[block].nsamples
+const f64 *
+telemetry_reader_columns(telemetry_reader *r, u64 block)
+{
+    const f64 *base = NULL;
+    for (u32 c = 0; c < r->header.ncol; c++)
+    {
+        const f64 *col = telemetry_reader_column(r, block, c);
+        if (!c) base = col;
+    }
+    return base;
+}
+
+f64
+telemetry_reader_col_min(telemetry_reader *r, u64 block, u32 col)
+{
+    return ((const f64 *)(r->map + r->blocks[block].offset))[col];
+}
+
+f64
+telemetry_reader_col_max(telemetry_reader *r, u64 block, u32 col)
+{
+    return ((const f64 *)(r->map + r->blocks[block].offset))[r->header.ncol + col];
+}
+
+// first block that can hold samples at or after time, for streaming a time range without touching earlier blocks
+u64
+telemetry_reader_first_block(telemetry_reader *r, f64 time)
+{
+    u64 lo = 0;
+    u64 hi = r->blocks.size();
+    while (lo < hi)
+    {
+        u64 mid = (lo + hi) / 2;
+        if (r->blocks[mid].t_max < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+u64
+telemetry_reader_block_of(telemetry_reader *r, u64 index)
+{
+    u64 lo = 0;
+    u64 hi = r->blocks.size();
+    while (hi - lo > 1)
+    {
+        u64 mid = (lo + hi) / 2;
+        if (r->blocks[mid].first <= index)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void
+telemetry_reader_sample(telemetry_reader *r, u64 index, f64 *values)
+{
+    u64 b = telemetry_reader_block_of(r, index);
+    const f64 *cols = telemetry_reader_columns(r, b);
+    u64 n = r->blocks[b].nsamples;
+    u64 i = index - r->blocks[b].first;
+    for (u32 c = 0; c < r->header.ncol; c++)
+        values[c] = cols[c * n + i];
+}
+
+// last sample with time <= time (0 if none)
+u64
+telemetry_reader_find(telemetry_reader *r, f64 time)
+{
+    if (r->blocks.empty()) return 0;
+    u64 lo = 0;
+    u64 hi = r->blocks.size();
+    while (hi - lo > 1)
+    {
+        u64 mid = (lo + hi) / 2;
+        if (r->blocks[mid].t_min <= time)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    const f64 *t = telemetry_reader_column(r, lo, 0);
+    u64 n = r->blocks[lo].nsamples;
+    u64 a = 0;
+    u64 b = n;
+    while (b - a > 1)
+    {
+        u64 mid = (a + b) / 2;
+        if (t[mid] <= time)
+            a = mid;
+        else
+            b = mid;
+    }
+    return r->blocks[lo].first + a;
+}
+
+// last keyframe with time <= time. Keyframes are evenly spaced in steps, so guess the slot directly and only fall back
+// to bisection when samples were dropped or the timestep changed.
+const telemetry_keyframe *
+telemetry_reader_keyframe(telemetry_reader *r, f64 time)
+{
+    if (!r->nkeys) return NULL;
+    const u8 *base = r->keys_map + sizeof(telemetry_keys_header);
+    const telemetry_keyframe *first = (const telemetry_keyframe *)base;
+    f64 spacing = r->header.timestep * r->keys_header.interval;
+    i64 guess = spacing > 0 ? (i64)((time - first->time) / spacing) : 0;
+    if (guess < 0) guess = 0;
+    if (guess >= (i64)r->nkeys) guess = r->nkeys - 1;
+
+    const telemetry_keyframe *kf = (const telemetry_keyframe *)(base + guess * r->keys_stride);
+    const telemetry_keyframe *next = guess + 1 < (i64)r->nkeys ? (const telemetry_keyframe *)(base + (guess + 1) * r->keys_stride) : NULL;
+    if (kf->time <= time && (!next || next->time > time)) return kf;
+
+    u64 lo = 0;
+    u64 hi = r->nkeys;
+    while (hi - lo > 1)
+    {
+        u64 mid = (lo + hi) / 2;
+        if (((const telemetry_keyframe *)(base + mid * r->keys_stride))->time <= time)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (const telemetry_keyframe *)(base + lo * r->keys_stride);
+}
@@ -14,6 +14,9 @@ void cursor_pos_callback(GLFWwindow *window, f64 xpos, f64 ypos);
 void scroll_callback(GLFWwindow *window, f64 xoffset, f64 yoffset);
 void draw_sim(world *w);
 void draw_panel(world *w);
+void draw_plot(world *w, const char *label, const char *unit, i32 channel_x, i32 channel_y);
+void draw_pole_plot(world *w);
+void draw_freq_plots(world *w);
 
 void
 init_ui(world *w)
@@ -47,19 +50,12 @@ init_ui(world *w)
     glfwSetCursorPosCallback(w->window, cursor_pos_callback);
     glfwSetScrollCallback(w->window, scroll_callback);
 
-    // mujoco data+model
-    char error[1000];
-    mjSpec *spec = mj_parseXMLString(scene, NULL, error, 1000);
-    w->model = mj_compile(spec, NULL);
-    assert(w->model);
-    w->data = mj_makeData(w->model);
-    assert(w->data);
-    // defaults
+    // defaults (model and data come from load_model)
     mjv_defaultScene(&w->scene);
     mjr_defaultContext(&w->context);
     mjv_defaultCamera(&w->cam);
     mjv_defaultOption(&w->opt);
-    mjv_makeScene(w->model, &w->scene, 2000);
+    mjv_makeScene(w->model, &w->scene, scene_max_geoms(w));
     mjr_makeContext(w->model, &w->context, mjFONTSCALE_150);
 
     reset_pole_orientation(w);
@@ -81,11 +77,12 @@ destroy_ui(world *w)
 void
 reset_pole_orientation(world *w)
 {
+    rng_stream rng = rng_open(w->seed, 0, w->episode++, RNG_INITIAL_STATE);
     if (w->pole_start_angle_random)
     {
         f64 max_angle = mjPI / 6;
-        w->data->qpos[w->hinge_x_qpos_id] = ((f64)rand() / RAND_MAX * 2.0 - 1.0) * max_angle;
-        w->data->qpos[w->hinge_y_qpos_id] = ((f64)rand() / RAND_MAX * 2.0 - 1.0) * max_angle;
+        w->data->qpos[w->hinge_x_qpos_id] = rng_symmetric(&rng) * max_angle;
+        w->data->qpos[w->hinge_y_qpos_id] = rng_symmetric(&rng) * max_angle;
     }
     else
     {
@@ -107,6 +104,8 @@ key_callback(GLFWwindow *window, i32 key, i32 scancode, i32 act, i32 mods)
 {
     world *w = (world *)glfwGetWindowUserPointer(window);
     ImGui_ImplGlfw_KeyCallback(window, key, scancode, act, mods);
+    // typing into a text field or navigating the panels is not a hotkey
+    if (ImGui::GetIO().WantCaptureKeyboard) return;
     if (act == GLFW_PRESS && key == GLFW_KEY_W)
     {
         w->data->qfrc_applied[w->hinge_x_qpos_id] = -5.0f;
@@ -123,12 +122,18 @@ key_callback(GLFWwindow *window, i32 key, i32 scancode, i32 act, i32 mods)
     {
         w->data->qfrc_applied[w->hinge_y_qpos_id] = 5.0f;
     }
+    // left arrow: rewind the live sim
+    if (act == GLFW_PRESS && key == GLFW_KEY_LEFT && !w->replay)
+    {
+        rewind_to(w, w->data->time - w->rewind_seconds);
+    }
     // backspace: reset simulation
     if (act == GLFW_PRESS && key == GLFW_KEY_BACKSPACE)
     {
         mj_resetData(w->model, w->data);
         reset_pole_orientation(w);
         mj_forward(w->model, w->data);
+        fleet_reset_all(w);
     }
     // escape: close window
     else if (act == GLFW_PRESS && key == GLFW_KEY_ESCAPE)
@@ -235,15 +240,178 @@ draw_sim(world *w)
     mjrRect viewport = { 0, 0, 0, 0 };
     glfwGetFramebufferSize(w->window, &viewport.width, &viewport.height);
 
-    mj_step(w->model, w->data);
-    mjv_updateScene(w->model, w->data, &w->opt, NULL, &w->cam, mjCAT_ALL, &w->scene);
+    mjData *d = w->replay ? w->replay->data : w->data;
+    mjv_updateScene(w->model, d, &w->opt, NULL, &w->cam, mjCAT_ALL, &w->scene);
+    fleet_add_geoms(w);
     mjr_render(viewport, &w->scene, &w->context);
 
     if (w->focus_robot)
     {
-        w->cam.lookat[0] = w->data->qpos[w->platform_x_qpos_id];
-        w->cam.lookat[1] = w->data->qpos[w->platform_y_qpos_id];
+        w->cam.lookat[0] = d->qpos[w->platform_x_qpos_id];
+        w->cam.lookat[1] = d->qpos[w->platform_y_qpos_id];
+    }
+}
+
+// x and y channels of the last plot_seconds as per-pixel min/max, so the vertex count is bounded by the plot width
+void
+draw_plot(world *w, const char *label, const char *unit, i32 channel_x, i32 channel_y)
+{
+    static f32 lo[2][PLOT_MAX_WIDTH];
+    static f32 hi[2][PLOT_MAX_WIDTH];
+    static ImVec2 points[2 * PLOT_MAX_WIDTH];
+    const ImU32 colors[2] = { IM_COL32(230, 90, 90, 255), IM_COL32(90, 160, 230, 255) };
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size(ImGui::GetContentRegionAvail().x, 70.0f);
+    i32 width = mjMAX(1, mjMIN(PLOT_MAX_WIDTH, (i32)size.x));
+    ImGui::Dummy(size);
+
+    f32 bottom = FLT_MAX;
+    f32 top = -FLT_MAX;
+    i32 channels[2] = { channel_x, channel_y };
+    for (i32 c = 0; c < 2; c++)
+    {
+        plot_decimate(w, channels[c], w->plot_seconds, width, lo[c], hi[c]);
+        for (i32 p = 0; p < width; p++)
+        {
+            bottom = mjMIN(bottom, lo[c][p]);
+            top = mjMAX(top, hi[c][p]);
+        }
+    }
+    if (bottom > top) bottom = top = 0.0f;
+    f32 pad = mjMAX(1e-6f, 0.05f * (top - bottom));
+    bottom -= pad;
+    top += pad;
+
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), ImGui::GetColorU32(ImGuiCol_FrameBg));
+    f32 scale = size.y / (top - bottom);
+    if (bottom < 0.0f && top > 0.0f)
+    {
+        f32 zero = origin.y + top * scale;
+        draw->AddLine(ImVec2(origin.x, zero), ImVec2(origin.x + size.x, zero), IM_COL32(255, 255, 255, 40));
+    }
+    for (i32 c = 0; c < 2; c++)
+    {
+        // zigzag through each column's extremes, which fills the band where the signal is dense
+        i32 n = 0;
+        for (i32 p = 0; p < width; p++)
+        {
+            if (lo[c][p] > hi[c][p]) continue;
+            bool down = n & 2;
+            points[n++] = ImVec2(origin.x + p, origin.y + (top - (down ? hi[c][p] : lo[c][p])) * scale);
+            points[n++] = ImVec2(origin.x + p, origin.y + (top - (down ? lo[c][p] : hi[c][p])) * scale);
+        }
+        draw->AddPolyline(points, n, colors[c], 0, 1.0f);
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "%s [%s]  %.3g .. %.3g", label, unit, bottom + pad, top - pad);
+    draw->AddText(ImVec2(origin.x + 4, origin.y + 2), IM_COL32(255, 255, 255, 200), text);
+}
+
+// complex plane with the root locus of the selected Q weight (dim to bright as the weight grows) and the current poles
+void
+draw_pole_plot(world *w)
+{
+    const locus_trace *t = locus_request(w, w->locus_weight);
+    i32 done = t->done.load(std::memory_order_acquire);
+
+    f64 re_min = -1e-3;
+    f64 im_max = 1e-3;
+    for (i32 k = 0; k < nstate; k++)
+    {
+        re_min = mjMIN(re_min, w->poles(k).real());
+        im_max = mjMAX(im_max, fabs(w->poles(k).imag()));
+    }
+    for (i32 i = 0; i < done; i++)
+        for (i32 k = 0; k < nstate && t->solved[i]; k++)
+        {
+            re_min = mjMIN(re_min, t->poles[i][k].real());
+            im_max = mjMAX(im_max, fabs(t->poles[i][k].imag()));
+        }
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size(ImGui::GetContentRegionAvail().x, 160.0f);
+    ImGui::Dummy(size);
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+    // left half plane plus a margin right of the imaginary axis, equal scale on both axes
+    f64 re_span = -re_min * 1.15;
+    f64 scale = mjMIN(size.x / re_span, size.y / (2.3 * im_max));
+    f32 axis_x = origin.x + size.x - (f32)(0.1 * re_span * scale);
+    f32 axis_y = origin.y + 0.5f * size.y;
+    auto to_screen = [&](std::complex<f64> p) { return ImVec2(axis_x + (f32)(p.real() * scale), axis_y - (f32)(p.imag() * scale)); };
+    draw->AddLine(ImVec2(origin.x, axis_y), ImVec2(origin.x + size.x, axis_y), IM_COL32(255, 255, 255, 40));
+    draw->AddLine(ImVec2(axis_x, origin.y), ImVec2(axis_x, origin.y + size.y), IM_COL32(255, 255, 255, 40));
+
+    for (i32 i = 0; i < done; i++)
+    {
+        if (!t->solved[i]) continue;
+        i32 shade = 60 + 195 * i / (LOCUS_POINTS - 1);
+        for (i32 k = 0; k < nstate; k++)
+            draw->AddCircleFilled(to_screen(t->poles[i][k]), 1.5f, IM_COL32(shade, shade, 90, 255));
+    }
+    for (i32 k = 0; k < nstate; k++)
+    {
+        ImVec2 p = to_screen(w->poles(k));
+        draw->AddLine(ImVec2(p.x - 4, p.y - 4), ImVec2(p.x + 4, p.y + 4), IM_COL32(230, 90, 90, 255), 2.0f);
+        draw->AddLine(ImVec2(p.x - 4, p.y + 4), ImVec2(p.x + 4, p.y - 4), IM_COL32(230, 90, 90, 255), 2.0f);
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "Re >= %.3g, |Im| <= %.3g%s", re_min, im_max, done < LOCUS_POINTS ? "  (solving)" : "");
+    draw->AddText(ImVec2(origin.x + 4, origin.y + 2), IM_COL32(255, 255, 255, 200), text);
+}
+
+// Bode magnitude and phase over log frequency, and the Nyquist curve around -1
+void
+draw_freq_plots(world *w)
+{
+    static ImVec2 points[FREQ_POINTS];
+    const freq_response *f = w->freq;
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    f32 width = ImGui::GetContentRegionAvail().x;
+
+    auto curve = [&](const char *label, const f64 *xs, const f64 *ys, f64 x0, f64 x1, f64 y0, f64 y1, f64 y_mark, f32 height) {
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Dummy(ImVec2(width, height));
+        draw->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), ImGui::GetColorU32(ImGuiCol_FrameBg));
+        f64 sx = width / (x1 - x0);
+        f64 sy = height / (y1 - y0);
+        if (y_mark > y0 && y_mark < y1)
+        {
+            f32 y = origin.y + (f32)((y1 - y_mark) * sy);
+            draw->AddLine(ImVec2(origin.x, y), ImVec2(origin.x + width, y), IM_COL32(255, 255, 255, 40));
+        }
+        for (i32 i = 0; i < FREQ_POINTS; i++)
+        {
+            f64 x = mjMAX(x0, mjMIN(x1, xs[i]));
+            f64 y = mjMAX(y0, mjMIN(y1, ys[i]));
+            points[i] = ImVec2(origin.x + (f32)((x - x0) * sx), origin.y + (f32)((y1 - y) * sy));
+        }
+        draw->AddPolyline(points, FREQ_POINTS, IM_COL32(90, 160, 230, 255), 0, 1.0f);
+        draw->AddText(ImVec2(origin.x + 4, origin.y + 2), IM_COL32(255, 255, 255, 200), label);
+    };
+
+    static f64 log_omega[FREQ_POINTS];
+    f64 mag_lo = 1e300, mag_hi = -1e300, phase_lo = 1e300, phase_hi = -1e300;
+    for (i32 i = 0; i < FREQ_POINTS; i++)
+    {
+        log_omega[i] = log10(f->omega[i]);
+        mag_lo = mjMIN(mag_lo, f->mag_db[i]);
+        mag_hi = mjMAX(mag_hi, f->mag_db[i]);
+        phase_lo = mjMIN(phase_lo, f->phase_deg[i]);
+        phase_hi = mjMAX(phase_hi, f->phase_deg[i]);
     }
+    f64 w0 = log_omega[0];
+    f64 w1 = log_omega[FREQ_POINTS - 1];
+    curve("|L| dB (0 dB line)", log_omega, f->mag_db, w0, w1, mjMAX(mag_lo, -80.0) - 5, mjMIN(mag_hi, 80.0) + 5, 0.0, 80.0f);
+    f64 turn = -180.0 + 360.0 * round((0.5 * (phase_lo + phase_hi) + 180.0) / 360.0);
+    curve("arg L deg (-180 line)", log_omega, f->phase_deg, w0, w1, phase_lo - 10, phase_hi + 10, turn, 80.0f);
+
+    // Nyquist: zoom on the critical point so the encirclements stay readable
+    f64 r = 4.0;
+    curve("Nyquist (real axis, -1 at center)", f->re, f->im, -1.0 - r, -1.0 + r, -r * 0.5, r * 0.5, 0.0, 120.0f);
 }
 
 void
@@ -263,6 +431,17 @@ draw_panel(world *w)
                      ImGuiWindowFlags_NoBringToFrontOnFocus);
     w->panel_width = ImGui::GetWindowWidth();
 
+    if (w->falling_behind)
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Falling behind: %.2fx real time at max timestep %.4f s", w->measured_rtf, w->max_timestep);
+    }
+    if (w->reload)
+    {
+        char status[256];
+        reload_status(w, status, sizeof(status));
+        ImGui::TextWrapped("Scene: %s", status);
+    }
+
     if (ImGui::CollapsingHeader("LQR Controller", ImGuiTreeNodeFlags_DefaultOpen))
     {
         ImGui::Text("Set LQR Penalties");
@@ -295,6 +474,10 @@ draw_panel(world *w)
         ImGui::Separator();
         ImGui::Text("LQR Gain Matrix K");
         ImGui::Text("%8.3f %8.3f %8.3f %8.3f", w->K(0, 0), w->K(0, 1), w->K(0, 2), w->K(0, 3));
+        const char *sources[] = { "solved", "cached (exact)", "cached (nearest)" };
+        ImGui::Text("Gain source: %s, %llu cached", sources[w->gain_source], (unsigned long long)mjMIN(w->gains->count, (u64)GAIN_CACHE_MAX));
+        ImGui::Text("Syntheses: %llu, %llu CARE failures", (unsigned long long)w->gain_recomputes, (unsigned long long)w->care_failures);
+        ImGui::SliderFloat("Nearest-gain tolerance", &w->gain_tolerance, 0.0f, 0.1f, "%.3f");
         if (ImGui::Button("Reset Q"))
         {
             w->q_pos_penalty = 10.0f;
@@ -311,9 +494,58 @@ draw_panel(world *w)
         if (ImGui::Button("Set K = 0"))
         {
             w->K.setZero();
+            update_poles(w);
+        }
+        ImGui::Checkbox("Run inside mj_step (mjcb_control)", &w->control_in_mujoco);
+    }
+
+    if (ImGui::CollapsingHeader("Physical Parameters"))
+    {
+        // every change recompiles the model in place; the gain follows from the cache or a background solve
+        params_state *ps = w->params;
+        const f64 mass_min = 0.1, mass_max = 1000.0, length_min = 0.1, length_max = 5.0;
+        bool edited = false;
+        edited |= ImGui::SliderScalar("Pole mass", ImGuiDataType_Double, &w->pole_mass, &mass_min, &mass_max, "%.2f kg",
+                                      ImGuiSliderFlags_Logarithmic);
+        edited |= ImGui::SliderScalar("Pole length", ImGuiDataType_Double, &w->pole_length, &length_min, &length_max, "%.2f m",
+                                      ImGuiSliderFlags_Logarithmic);
+        edited |= ImGui::SliderScalar("Platform mass", ImGuiDataType_Double, &w->platform_mass, &mass_min, &mass_max, "%.2f kg",
+                                      ImGuiSliderFlags_Logarithmic);
+        if (edited) params_apply(w);
+        if (ImGui::Button("Restore loaded values")) params_restore(w);
+        ImGui::TextWrapped("Model: %s", ps->status);
+        if (ps->edits) ImGui::Text("%llu edits, spec parsed once in %.2f ms", (unsigned long long)ps->edits, ps->parse_ms);
+    }
+
+    if (ImGui::CollapsingHeader("Closed-Loop Poles"))
+    {
+        const char *weights[nstate] = { "Position", "Angle", "Velocity", "Angular velocity" };
+        ImGui::Combo("Root locus over", &w->locus_weight, weights, nstate);
+        draw_pole_plot(w);
+        for (i32 k = 0; k < nstate; k++)
+        {
+            std::complex<f64> p = w->poles(k);
+            f64 wn = std::abs(p);
+            ImGui::Text("%9.3f %+9.3fi   wn %7.3f rad/s   zeta %6.3f", p.real(), p.imag(), wn, wn > 0 ? -p.real() / wn : 0.0);
         }
     }
 
+    if (ImGui::CollapsingHeader("Frequency Response"))
+    {
+        freq_update(w);
+        freq_response *f = w->freq;
+        ImGui::Text("Loop L(jw) = K (jwI - A)^-1 B, %d points in %.2f ms", FREQ_POINTS, f->elapsed_ms);
+        if (isinf(f->gain_margin_db))
+            ImGui::Text("Gain margin      : none (phase never crosses -180)");
+        else
+            ImGui::Text("Gain margin      : %+.2f dB at %.3g rad/s", f->gain_margin_db, f->gain_margin_omega);
+        if (isinf(f->phase_margin_deg))
+            ImGui::Text("Phase margin     : none (|L| never crosses 1)");
+        else
+            ImGui::Text("Phase margin     : %.1f deg at %.3g rad/s", f->phase_margin_deg, f->phase_margin_omega);
+        draw_freq_plots(w);
+    }
+
     if (ImGui::CollapsingHeader("State & Control", ImGuiTreeNodeFlags_DefaultOpen))
     {
         ImGui::Text("Position         : (%8.3f m,     %8.3f m    )", w->x(0), w->y(0));
@@ -321,6 +553,10 @@ draw_panel(world *w)
         ImGui::Text("Velocity         : (%8.3f m/s,   %8.3f m/s  )", w->x(2), w->y(2));
         ImGui::Text("Angular Velocity : (%8.3f rad/s, %8.3f rad/s)", w->x(3), w->y(3));
         ImGui::Text("Control Input    : (%8.3f N,     %8.3f N    )", w->ux, w->uy);
+        ImGui::SliderFloat("History", &w->plot_seconds, 1.0f, 60.0f, "%.0f s");
+        draw_plot(w, "Angle", "rad", PLOT_ANGLE_X, PLOT_ANGLE_Y);
+        draw_plot(w, "Position", "m", PLOT_POSITION_X, PLOT_POSITION_Y);
+        draw_plot(w, "Force", "N", PLOT_FORCE_X, PLOT_FORCE_Y);
     }
 
     if (ImGui::CollapsingHeader("Pole Angle", ImGuiTreeNodeFlags_DefaultOpen))
@@ -344,9 +580,159 @@ draw_panel(world *w)
         ImGui::NewLine();
     }
 
+    if (ImGui::CollapsingHeader("Rewind"))
+    {
+        rewind_buffer *rb = w->rewind;
+        f64 oldest = rewind_oldest(w);
+        ImGui::Text("History          : %.2f s (%llu snapshots)", w->data->time - oldest, (unsigned long long)(rb ? rb->frames : 0));
+        u64 raw = rb ? rb->frames * rb->state_size * sizeof(f64) : 0;
+        u64 bytes = rewind_bytes(w);
+        ImGui::Text("Memory           : %.2f MB (%.1fx smaller than raw)", bytes / 1e6, bytes ? (f64)raw / bytes : 0.0);
+        ImGui::SliderFloat("Rewind by", &w->rewind_seconds, 0.1f, 10.0f, "%.1f s");
+        if (ImGui::Button("Rewind (Left Arrow)") && !w->replay) rewind_to(w, w->data->time - w->rewind_seconds);
+    }
+
+    if (ImGui::CollapsingHeader("Telemetry"))
+    {
+        ImGui::InputText("Log file", w->telemetry_path, sizeof(w->telemetry_path));
+        if (!w->recorder)
+        {
+            ImGui::Checkbox("Compress", &w->telemetry_compress);
+            if (w->telemetry_compress) ImGui::InputDouble("Resolution (0: lossless)", &w->telemetry_quantum, 0.0, 0.0, "%g");
+            if (ImGui::Button("Start Recording")) telemetry_start(w, w->telemetry_path);
+        }
+        else
+        {
+            if (ImGui::Button("Stop Recording")) telemetry_stop(w);
+        }
+        if (w->recorder)
+        {
+            ImGui::Text("Samples written  : %llu", (unsigned long long)w->recorder->written.load(std::memory_order_relaxed));
+            ImGui::Text("Samples dropped  : %llu", (unsigned long long)w->recorder->dropped.load(std::memory_order_relaxed));
+            if (w->recorder->failed.load(std::memory_order_relaxed))
+                ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Write failed, log ends at the last complete block");
+            u64 bytes = w->recorder->bytes.load(std::memory_order_relaxed);
+            u64 raw = w->recorder->written.load(std::memory_order_relaxed) * w->recorder->header.ncol * sizeof(f64);
+            ImGui::Text("File size        : %.2f MB (%.1fx smaller than raw)", bytes / 1e6, bytes ? (f64)raw / bytes : 0.0);
+        }
+        if (w->stream)
+        {
+            ImGui::Separator();
+            ImGui::Text("Stream           : %s", w->stream->path);
+            ImGui::Text("Subscribers      : %d", w->stream->nsubscribers.load(std::memory_order_relaxed));
+            ImGui::Text("Frames sent      : %llu", (unsigned long long)w->stream->frames_sent.load(std::memory_order_relaxed));
+            ImGui::Text("Frames dropped   : %llu", (unsigned long long)w->stream->frames_dropped.load(std::memory_order_relaxed));
+            ImGui::Text("Samples dropped  : %llu", (unsigned long long)w->stream->dropped_samples.load(std::memory_order_relaxed));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Replay"))
+    {
+        ImGui::InputText("Replay file", w->replay_path, sizeof(w->replay_path));
+        if (!w->replay)
+        {
+            if (ImGui::Button("Open Replay")) replay_open(w, w->replay_path);
+        }
+        else
+        {
+            replay_state *rs = w->replay;
+            f32 t = (f32)rs->time;
+            if (ImGui::SliderFloat("Time", &t, (f32)rs->t_begin, (f32)rs->t_end, "%.3f s"))
+            {
+                rs->playing = false;
+                replay_seek(w, t);
+            }
+            if (ImGui::Button(rs->playing ? "Pause" : "Play")) rs->playing = !rs->playing;
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(150.0f);
+            ImGui::SliderFloat("Speed", &rs->speed, 0.1f, 10.0f, "%.1fx", ImGuiSliderFlags_Logarithmic);
+            ImGui::Text("%llu samples, %llu keyframes", (unsigned long long)rs->reader.nsamples, (unsigned long long)rs->reader.nkeys);
+            if (ImGui::Button("Resume Simulation Here")) replay_resume(w);
+            ImGui::SameLine();
+            if (ImGui::Button("Close Replay")) replay_close(w);
+        }
+    }
+
+    if (w->fleet && ImGui::CollapsingHeader("Fleet"))
+    {
+        fleet_state *f = w->fleet;
+        ImGui::Text("%d pendulums on the shared model, %llu restarted after falling", f->n, (unsigned long long)f->falls);
+        ImGui::Text("Fleet step       : %8.1f us (%.0f ns per pendulum)", f->step_ns / 1e3, f->step_ns / f->n);
+        ImGui::Text("Fleet control    : %8.1f us (%.2f ns per pendulum, %s)", f->control_ns / 1e3, f->control_ns / f->n,
+                    batch_isa_names[batch_isa]);
+        ImGui::SliderFloat("Gain spread", &w->fleet_gain_spread, 0.0f, 1.0f, "+/- %.2f");
+        if (ImGui::Button("Restart fleet")) fleet_reset_all(w);
+    }
+
+    if (w->ext && ImGui::CollapsingHeader("External Controller", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ext_link *e = w->ext;
+        if (!e->attached)
+            ImGui::TextColored(ImVec4(0.8f, 0.8f, 0.2f, 1.0f), "No controller on %s, LQR in control", e->name);
+        else if (w->control_in_mujoco)
+            ImGui::TextColored(ImVec4(0.8f, 0.8f, 0.2f, 1.0f), "Attached, but mjcb_control mode runs the built-in LQR");
+        else
+            ImGui::Text("Attached on %s", e->name);
+        ImGui::SliderInt("Deadline", &w->ext_deadline_us, 50, 10000, "%d us", ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Exchanges        : %llu, %llu missed (LQR used), %llu late", (unsigned long long)e->exchanges, (unsigned long long)e->misses,
+                    (unsigned long long)e->late);
+        ImGui::Text("Round trip       : p50 %.1f us, p99 %.1f us, max %.1f us", ext_rtt_percentile(w, 0.5) / 1e3,
+                    ext_rtt_percentile(w, 0.99) / 1e3, e->rtt_max_ns / 1e3);
+    }
+
+    if (ImGui::CollapsingHeader("Timing"))
+    {
+        ImGui::Text("Loop Rates");
+        ImGui::Separator();
+        ImGui::Checkbox("Adaptive substeps", &w->adaptive_substeps);
+        if (w->adaptive_substeps)
+        {
+            ImGui::SliderFloat("Target real-time factor", &w->target_rtf, 0.1f, 4.0f, "%.2f");
+            ImGui::SliderFloat("Physics budget", &w->physics_budget, 0.1f, 0.9f, "%.2f of frame");
+            ImGui::Text("Physics rate     : %.0f Hz (%.1f us per substep)", w->physics_hz, w->step_cost_ns / 1e3);
+        }
+        else
+        {
+            ImGui::SliderFloat("Physics rate", &w->physics_hz, 50.0f, 2000.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+        }
+        if (w->control_in_mujoco)
+            ImGui::Text("Control rate     : every substep (mjcb_control)");
+        else
+            ImGui::SliderFloat("Control rate", &w->control_hz, 1.0f, 1000.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Render rate", &w->render_hz, 10.0f, 240.0f, "%.0f Hz");
+        if (w->control_hz > w->physics_hz) w->control_hz = w->physics_hz;
+        ImGui::Text("Measured         : physics %.0f Hz, control %.0f Hz, render %.0f Hz", //
+                    w->measured_physics_hz, w->measured_control_hz, w->measured_render_hz);
+        ImGui::Text("Real-time factor : %.3f", w->measured_rtf);
+        ImGui::Text("Timestep         : %.4f s", w->model->opt.timestep);
+        ImGui::Text("Hot-path allocs  : %llu from %d call sites", (unsigned long long)alloc_guard_count(), alloc_guard_sites());
+        ImGui::Text("Startup          : %.1f ms, model %s", (w->startup_mark_ns - w->startup_start_ns) / 1e6, w->model_from_cache ? "from cache" : "compiled");
+        for (i32 i = 0; i < w->startup_nstages; i++)
+            ImGui::Text("  %-14s : %.1f ms", w->startup_stage[i], w->startup_ms[i]);
+        ImGui::Separator();
+
+        if (w->rt_enabled)
+        {
+            ImGui::Text("Real-time loop   : %.3f ms period", w->rt_period_ns / 1e6);
+            ImGui::Text("mlockall / pinned / FIFO : %s / %s / %s", w->rt_locked ? "yes" : "no", w->rt_pinned ? "yes" : "no", w->rt_fifo ? "yes" : "no");
+            ImGui::Text("Periods          : %llu", (unsigned long long)w->rt_periods);
+            ImGui::Text("Deadline misses  : %llu", (unsigned long long)w->rt_misses);
+            ImGui::Text("Max jitter       : %.1f us", w->rt_max_jitter_ns / 1e3);
+            f32 hist[RT_HIST_BINS];
+            for (i32 i = 0; i < RT_HIST_BINS; i++)
+                hist[i] = (f32)w->rt_jitter_hist[i];
+            ImGui::PlotHistogram("Jitter (log2 us)", hist, RT_HIST_BINS, 0, NULL, 0.0f, FLT_MAX, ImVec2(0, 60));
+        }
+        else
+        {
+            ImGui::TextColored(ImVec4(0.8f, 0.8f, 0.2f, 1.0f), "Real-time loop disabled (run with --rt)");
+        }
+    }
+
     if (ImGui::Button("Reset Simulation"))
     {
         mj_resetData(w->model, w->data);
+        fleet_reset_all(w);
     }
     ImGui::Checkbox("Focus Camera on Robot", &w->focus_robot);
 
@@ -0,0 +1,324 @@
+#include "base.hpp"
+#include "vecenv.h"
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+// Implementation of vecenv.h. The environments are split into one contiguous range per thread, the same ranges on
+// every call, so a given environment is always stepped by the same thread. Reward and termination are evaluated after
+// each physics step from the same (noise-free) state the observation is built from. Start tilts, disturbances and
+// observation noise come from counter-based streams keyed by (seed, environment, episode), so results are bitwise the
+// same for any number of threads. The gain behind vecenv_lqr_actions comes from the simulator's own linearization and
+// CARE solve on the shared model.
+
+typedef void (*vecenv_job)(vecenv *env, i32 begin, i32 end);
+
+struct vecenv {
+    world w; // shared model, joint ids, Q, R and K
+    vecenv_config config;
+    i32 n;
+    mjData **data;
+    u32 *episode;             // episodes started per environment
+    rng_stream *disturbances; // per environment, for its current episode
+    rng_stream *noise;
+
+    // arguments of the call in flight
+    const u8 *mask;
+    const f64 *actions;
+    f64 *obs;
+    f64 *reward;
+    u8 *done;
+    f64 *terminal_obs;
+
+    // thread pool; thread t runs environments [n * t / nthreads, n * (t + 1) / nthreads)
+    i32 nthreads;
+    std::thread *threads;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    vecenv_job job;
+    u64 generation;
+    i32 pending;
+    bool quit;
+};
+
+void
+vecenv_observe(vecenv *env, i32 i, f64 *obs)
+{
+    Eigen::Matrix<f64, nstate, 1> x;
+    Eigen::Matrix<f64, nstate, 1> y;
+    read_state_from_data(&env->w, env->data[i], x, y);
+    for (i32 k = 0; k < nstate; k++)
+    {
+        obs[k] = x(k);
+        obs[nstate + k] = y(k);
+    }
+    if (env->config.obs_noise > 0)
+        for (i32 k = 0; k < VECENV_OBS_DIM; k++)
+            obs[k] += env->config.obs_noise * rng_normal(&env->noise[i]);
+}
+
+void
+vecenv_reset_one(vecenv *env, i32 i)
+{
+    const world *w = &env->w;
+    mjData *d = env->data[i];
+    u32 episode = env->episode[i]++;
+    rng_stream start = rng_open(env->config.seed, i, episode, RNG_INITIAL_STATE);
+    env->disturbances[i] = rng_open(env->config.seed, i, episode, RNG_DISTURBANCE);
+    env->noise[i] = rng_open(env->config.seed, i, episode, RNG_SENSOR_NOISE);
+    mj_resetData(w->model, d);
+    d->qpos[w->hinge_x_qpos_id] = rng_symmetric(&start) * env->config.start_angle;
+    d->qpos[w->hinge_y_qpos_id] = rng_symmetric(&start) * env->config.start_angle;
+    mj_forward(w->model, d);
+}
+
+void
+vecenv_reset_range(vecenv *env, i32 begin, i32 end)
+{
+    for (i32 i = begin; i < end; i++)
+    {
+        if (!env->mask || env->mask[i]) vecenv_reset_one(env, i);
+        vecenv_observe(env, i, env->obs + i * VECENV_OBS_DIM);
+    }
+}
+
+void
+vecenv_step_range(vecenv *env, i32 begin, i32 end)
+{
+    const world *w = &env->w;
+    const mjModel *m = w->model;
+    for (i32 i = begin; i < end; i++)
+    {
+        mjData *d = env->data[i];
+        f64 ux = env->actions[i * VECENV_ACT_DIM];
+        f64 uy = env->actions[i * VECENV_ACT_DIM + 1];
+        f64 cost = 0.0;
+        u8 done = 0;
+        for (i32 s = 0; s < env->config.frame_skip && !done; s++)
+        {
+            d->ctrl[0] = ux;
+            d->ctrl[1] = uy;
+            if (env->config.disturbance > 0)
+            {
+                d->qfrc_applied[w->hinge_x_qvel_id] = env->config.disturbance * rng_normal(&env->disturbances[i]);
+                d->qfrc_applied[w->hinge_y_qvel_id] = env->config.disturbance * rng_normal(&env->disturbances[i]);
+            }
+            mj_step(m, d);
+            Eigen::Matrix<f64, nstate, 1> x;
+            Eigen::Matrix<f64, nstate, 1> y;
+            read_state_from_data(w, d, x, y);
+            cost += (x.dot(w->Q * x) + y.dot(w->Q * y) + w->R * (d->ctrl[0] * d->ctrl[0] + d->ctrl[1] * d->ctrl[1])) * m->opt.timestep;
+            if (fabs(x(1)) > env->config.max_angle || fabs(y(1)) > env->config.max_angle)
+                done = VECENV_TERMINATED;
+            else if (env->config.max_time > 0 && d->time >= env->config.max_time)
+                done = VECENV_TRUNCATED;
+        }
+        env->reward[i] = -cost;
+        env->done[i] = done;
+
+        f64 *obs = env->obs + i * VECENV_OBS_DIM;
+        vecenv_observe(env, i, obs);
+        if (done && env->config.auto_reset)
+        {
+            if (env->terminal_obs) mju_copy(env->terminal_obs + i * VECENV_OBS_DIM, obs, VECENV_OBS_DIM);
+            vecenv_reset_one(env, i);
+            vecenv_observe(env, i, obs);
+        }
+    }
+}
+
+void
+vecenv_worker(vecenv *env, i32 t)
+{
+    i32 begin = (i32)((i64)env->n * t / env->nthreads);
+    i32 end = (i32)((i64)env->n * (t + 1) / env->nthreads);
+    u64 seen = 0;
+    std::unique_lock<std::mutex> guard(env->lock);
+    for (;;)
+    {
+        env->wake.wait(guard, [&] { return env->quit || env->generation != seen; });
+        if (env->quit) return;
+        seen = env->generation;
+        vecenv_job job = env->job;
+        guard.unlock();
+        job(env, begin, end);
+        guard.lock();
+        if (--env->pending == 0) env->finished.notify_one();
+    }
+}
+
+// run job over all environments; the calling thread takes the first range
+void
+vecenv_run(vecenv *env, vecenv_job job)
+{
+    if (env->nthreads == 1)
+    {
+        job(env, 0, env->n);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(env->lock);
+        env->job = job;
+        env->pending = env->nthreads - 1;
+        env->generation++;
+    }
+    env->wake.notify_all();
+    job(env, 0, (i32)((i64)env->n / env->nthreads));
+    std::unique_lock<std::mutex> guard(env->lock);
+    env->finished.wait(guard, [&] { return env->pending == 0; });
+}
+
+extern "C" void
+vecenv_default_config(vecenv_config *config)
+{
+    world defaults = {};
+    *config = {};
+    config->threads = 0;
+    config->frame_skip = 1;
+    config->auto_reset = 1;
+    config->max_time = 10.0;
+    config->max_angle = 1.0;
+    config->start_angle = mjPI / 12;
+    config->disturbance = 0.0;
+    config->obs_noise = 0.0;
+    config->q[0] = defaults.q_pos_penalty;
+    config->q[1] = defaults.q_angle_penalty;
+    config->q[2] = defaults.q_vel_penalty;
+    config->q[3] = defaults.q_angvel_penalty;
+    config->r = defaults.R;
+    config->seed = 0;
+    config->scene_path = NULL;
+    config->cache_dir = "cache";
+}
+
+extern "C" vecenv *
+vecenv_create(i32 n_envs, const vecenv_config *config)
+{
+    if (n_envs <= 0) return NULL;
+    vecenv *env = new vecenv();
+    if (config)
+        env->config = *config;
+    else
+        vecenv_default_config(&env->config);
+    env->config.frame_skip = mjMAX(1, env->config.frame_skip);
+
+    // the shared model, through the same MJB cache as the simulator; the one gain at Q, R is solved without gains.bin
+    world *w = &env->w;
+    w->model_cache = env->config.cache_dir != NULL;
+    if (w->model_cache) snprintf(w->cache_dir, sizeof(w->cache_dir), "%s", env->config.cache_dir);
+    w->use_gain_cache = false;
+    char *file_xml = env->config.scene_path ? read_text_file(env->config.scene_path) : NULL;
+    if (env->config.scene_path && !file_xml)
+    {
+        fprintf(stderr, "vecenv: cannot read %s\n", env->config.scene_path);
+        delete env;
+        return NULL;
+    }
+    char error[1000];
+    bool from_cache;
+    w->model = compile_scene(w, file_xml ? file_xml : scene, &from_cache, error, sizeof(error));
+    free(file_xml);
+    if (!w->model)
+    {
+        fprintf(stderr, "vecenv: %s\n", error);
+        delete env;
+        return NULL;
+    }
+    for (const char *joint : { "platform_x", "platform_y", "hinge_x", "hinge_y" })
+    {
+        if (mj_name2id(w->model, mjOBJ_JOINT, joint) >= 0) continue;
+        fprintf(stderr, "vecenv: the scene has no joint '%s'\n", joint);
+        mj_deleteModel(w->model);
+        delete env;
+        return NULL;
+    }
+    w->data = mj_makeData(w->model);
+    w->model_hash = model_hash(w->model);
+    w->q_pos_penalty = (f32)env->config.q[0];
+    w->q_angle_penalty = (f32)env->config.q[1];
+    w->q_vel_penalty = (f32)env->config.q[2];
+    w->q_angvel_penalty = (f32)env->config.q[3];
+    w->R = env->config.r;
+    init_math(w);
+
+    env->n = n_envs;
+    env->data = (mjData **)calloc(n_envs, sizeof(mjData *));
+    env->episode = (u32 *)calloc(n_envs, sizeof(u32));
+    env->disturbances = (rng_stream *)calloc(n_envs, sizeof(rng_stream));
+    env->noise = (rng_stream *)calloc(n_envs, sizeof(rng_stream));
+    for (i32 i = 0; i < n_envs; i++)
+    {
+        env->data[i] = mj_makeData(w->model);
+        vecenv_reset_one(env, i);
+    }
+
+    i32 threads = env->config.threads > 0 ? env->config.threads : (i32)std::thread::hardware_concurrency();
+    env->nthreads = mjMAX(1, mjMIN(threads, n_envs));
+    env->threads = new std::thread[env->nthreads];
+    for (i32 t = 1; t < env->nthreads; t++)
+        env->threads[t] = std::thread(vecenv_worker, env, t);
+    return env;
+}
+
+extern "C" void
+vecenv_destroy(vecenv *env)
+{
+    if (!env) return;
+    {
+        std::lock_guard<std::mutex> guard(env->lock);
+        env->quit = true;
+    }
+    env->wake.notify_all();
+    for (i32 t = 1; t < env->nthreads; t++)
+        env->threads[t].join();
+    delete[] env->threads;
+    for (i32 i = 0; i < env->n; i++)
+        mj_deleteData(env->data[i]);
+    free(env->data);
+    free(env->episode);
+    free(env->disturbances);
+    free(env->noise);
+    mj_deleteData(env->w.data);
+    mj_deleteModel(env->w.model);
+    delete env;
+}
+
+extern "C" i32
+vecenv_num_envs(const vecenv *env)
+{
+    return env->n;
+}
+
+extern "C" void
+vecenv_reset(vecenv *env, const u8 *mask, f64 *obs)
+{
+    env->mask = mask;
+    env->obs = obs;
+    vecenv_run(env, vecenv_reset_range);
+}
+
+extern "C" void
+vecenv_step(vecenv *env, const f64 *actions, f64 *obs, f64 *reward, u8 *done, f64 *terminal_obs)
+{
+    env->actions = actions;
+    env->obs = obs;
+    env->reward = reward;
+    env->done = done;
+    env->terminal_obs = terminal_obs;
+    vecenv_run(env, vecenv_step_range);
+}
+
+extern "C" void
+vecenv_lqr_actions(const vecenv *env, const f64 *obs, f64 *actions)
+{
+    for (i32 i = 0; i < env->n; i++)
+    {
+        Eigen::Map<const Eigen::Matrix<f64, nstate, 1> > x(obs + i * VECENV_OBS_DIM);
+        Eigen::Map<const Eigen::Matrix<f64, nstate, 1> > y(obs + i * VECENV_OBS_DIM + nstate);
+        actions[i * VECENV_ACT_DIM] = -(env->w.K * x)(0);
+        actions[i * VECENV_ACT_DIM + 1] = -(env->w.K * y)(0);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Vectorized cart-pole environments for reinforcement learning, as a plain C API (built into libmuludnep by build.sh).
+// N independent pendulums share one compiled model; every call works on caller-provided contiguous buffers and steps
+// the environments in parallel on a thread pool.
+//
+// buffers, env-major:
+//   obs      n * VECENV_OBS_DIM   x (platform x, pole angle about y, their rates) then y (the same for the other axis)
+//   actions  n * VECENV_ACT_DIM   platform forces ux, uy
+//   reward   n                    minus the LQR cost x'Qx + R ux^2 + y'Qy + R uy^2 integrated over the step
+//   done     n                    0, VECENV_TERMINATED (the pole fell) or VECENV_TRUNCATED (time limit)
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VECENV_OBS_DIM 8
+#define VECENV_ACT_DIM 2
+#define VECENV_TERMINATED 1
+#define VECENV_TRUNCATED 2
+
+typedef struct vecenv vecenv;
+
+typedef struct vecenv_config {
+    int32_t threads;         // worker threads including the caller, 0 for one per core
+    int32_t frame_skip;      // physics steps per vecenv_step, the action held over them
+    int32_t auto_reset;      // reset finished environments inside vecenv_step
+    double max_time;         // episode time limit in seconds, 0 for none
+    double max_angle;        // a pole tilted further than this (rad) ends the episode
+    double start_angle;      // each tilt starts uniform in [-start_angle, start_angle]
+    double disturbance;      // std dev of a random torque (N m) on each hinge, redrawn every physics step; 0 for none
+    double obs_noise;        // std dev of gaussian noise on every observation entry; 0 for none
+    double q[4];             // reward weights diag(Q): position, angle, velocity, angular velocity
+    double r;                // reward weight on each force
+    uint64_t seed;           // with the environment and episode index, the only input to every random draw
+    const char *scene_path;  // MJCF file with the same joints as the built-in scene, NULL for the built-in one
+    const char *cache_dir;   // directory of the compiled-model cache (the simulator's --cache-dir), NULL to always compile
+} vecenv_config;
+
+// defaults: one thread per core, no frame skip, auto reset, 10 s episodes, no disturbance or noise, Q and R of the
+// simulator's LQR panel, the simulator's "cache" directory
+void vecenv_default_config(vecenv_config *config);
+
+// NULL if the scene cannot be loaded; config may be NULL for the defaults
+vecenv *vecenv_create(int32_t n_envs, const vecenv_config *config);
+void vecenv_destroy(vecenv *env);
+int32_t vecenv_num_envs(const vecenv *env);
+
+// reset the environments whose mask entry is nonzero (all when mask is NULL) and write every observation
+void vecenv_reset(vecenv *env, const uint8_t *mask, double *obs);
+
+// apply actions for frame_skip physics steps and write observations, rewards and done flags. With auto reset, an
+// environment that finished is reset and obs holds its first observation of the next episode; its last observation of
+// the finished one goes to terminal_obs when that is not NULL.
+void vecenv_step(vecenv *env, const double *actions, double *obs, double *reward, uint8_t *done, double *terminal_obs);
+
+// the simulator's LQR law for the reward's Q and R on a batch of observations, as a baseline policy
+void vecenv_lqr_actions(const vecenv *env, const double *obs, double *actions);
+
+#ifdef __cplusplus
+}
+#endif
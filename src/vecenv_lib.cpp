@@ -0,0 +1,9 @@
+// unity build of libmuludnep, the vectorized environment API of vecenv.h without the simulator UI
+#include "alloc.cpp"
+#include "clock.cpp"
+#include "hash.cpp"
+#include "rng.cpp"
+#include "gains.cpp"
+#include "math.cpp"
+#include "model.cpp"
+#include "vecenv.cpp"